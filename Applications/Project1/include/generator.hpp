@@ -1,27 +1,99 @@
 #pragma once
 
 #include <functional>
-#include <queue>
-#include <mutex>
+#include <atomic>
+#include <thread>
+#include <span>
+#include <string>
+#include <variant>
+#include <complex>
+#include <algorithm>
+
+#include "utils.hpp"
 
 namespace Physical {
 
+// block kernels, render(out, tick) writes the samples [tick, tick + out.size())
+
 template<typename T>
-class Generator {
+struct SilenceBlock {
+    void render(std::span<T> out, int) const noexcept {
+        std::fill(out.begin(), out.end(), T(0));
+    }
+};
+
+// a precomputed carrier scaled by amplitude
+template<typename T>
+struct ToneBlock {
+    std::span<const T> carrier;
+    T amplitude = 1;
+    void render(std::span<T> out, int tick) const noexcept {
+        for (auto i = 0; i < out.size(); i++)
+            out[i] = amplitude * carrier[tick + i];
+    }
+};
+
+// a constellation point on a pair of precomputed quadrature carriers
+template<typename T>
+struct SymbolBlock {
+    std::span<const T> carrier_cos, carrier_sin;
+    std::complex<T> point;
+    void render(std::span<T> out, int tick) const noexcept {
+        for (auto i = 0; i < out.size(); i++)
+            out[i] = point.real() * carrier_cos[tick + i] + point.imag() * carrier_sin[tick + i];
+    }
+};
+
+// a stored waveform played as is
+template<typename T>
+struct PreambleBlock {
+    std::span<const T> signal;
+    void render(std::span<T> out, int tick) const noexcept {
+        std::copy_n(signal.begin() + tick, out.size(), out.begin());
+    }
+};
+
+// fallback for waveforms without a dedicated kernel
+template<typename T>
+struct FunctionBlock {
     std::function<T(int)> func;
+    void render(std::span<T> out, int tick) const {
+        for (auto i = 0; i < out.size(); i++)
+            out[i] = func(tick + i);
+    }
+};
+
+template<typename T>
+class Generator {
+    using Block = std::variant<SilenceBlock<T>, ToneBlock<T>, SymbolBlock<T>, PreambleBlock<T>, FunctionBlock<T>>;
+    Block block;
     int ticks;
     int current_tick = 0;
 public:
-    std::string name;
-    Generator(std::function<T(int)> func, int ticks, std::string name = "")
-        : func(std::move(func)), ticks(ticks), name(std::move(name)) { }
+    const char *name;
+    Generator() : Generator(SilenceBlock<T> {}, 0) { }
+    Generator(Block block, int ticks, const char *name = "")
+        : block(std::move(block)), ticks(ticks), name(name) { }
+    Generator(std::function<T(int)> func, int ticks, const char *name = "")
+        : Generator(FunctionBlock<T> { std::move(func) }, ticks, name) { }
 
-    const Generator& operator=(const Generator&) = delete;
+    Generator(const Generator&) = delete;
+    Generator(Generator&&) noexcept = default;
+    Generator& operator=(const Generator&) = delete;
+    Generator& operator=(Generator&&) noexcept = default;
 
-    T next() { 
-        // if (current_tick == 0) 
-        //     std::cout << "(Sender) " << name << " started " << '\n';
-        return func(current_tick++); 
+    // fill the front of out, return the number of samples written
+    int render(std::span<T> out) {
+        auto n = std::min<int>(out.size(), size());
+        std::visit([&](const auto &b) { b.render(out.first(n), current_tick); }, block);
+        current_tick += n;
+        return n;
+    }
+
+    T next() {
+        T v = 0;
+        render(std::span(&v, 1));
+        return v;
     }
     bool empty() { return current_tick >= ticks; }
     int size() { return ticks - current_tick; }
@@ -30,45 +102,60 @@ public:
 
 };
 
+// transmit queue shared by one producer (Sender::send) and the audio thread
+// the audio thread never blocks and never frees a generator: consumed slots
+// are reused by the producer on a later push
 template<typename T>
 class GeneratorQueue {
-    std::queue<Generator<T>> queue;
-    std::mutex mutex;
-    int ticks = 0;
+    utils::SPSCQueue<Generator<T>> queue;
+    std::atomic<int> ticks = 0;
 public:
 
-    void push(Generator<T> gen) {
-        std::lock_guard<std::mutex> lock(mutex);
-        queue.push(std::move(gen));
-        ticks += queue.front().size();
+    explicit GeneratorQueue(size_t capacity = 1 << 12) : queue(capacity) { }
+
+    bool try_push(Generator<T> &&gen) {
+        auto n = gen.size();
+        if (!queue.try_push(std::move(gen)))
+            return false;
+        ticks += n;
+        return true;
     }
 
-    Generator<T> pop() {
-        std::lock_guard<std::mutex> lock(mutex);
-        auto gen = queue.front();
-        queue.pop();
-        ticks -= gen.size();
-        return gen;
+    // wait for the audio thread to free a slot if the queue is full
+    void push(Generator<T> &&gen) {
+        auto n = gen.size();
+        while (!queue.try_push(std::move(gen)))
+            std::this_thread::yield();
+        ticks += n;
     }
 
-    bool empty() {
+    bool empty() const {
         return queue.empty();
     }
 
-    int size() {
+    int size() const {
         return ticks;
     }
 
-    T next() {
-        if (queue.empty())
-            return 0;
-        auto& gen = queue.front();
-        if (gen.empty()) {
-            pop();
-            return next();
+    // fill out with queued generators, pad with zeros when the queue runs dry
+    void render(std::span<T> out) {
+        while (!out.empty()) {
+            auto gen = queue.front();
+            if (gen == nullptr)
+                break;
+            auto n = gen->render(out);
+            ticks -= n;
+            out = out.subspan(n);
+            if (gen->empty())
+                queue.pop();
         }
-        ticks -= 1;
-        return gen.next();
+        std::fill(out.begin(), out.end(), T(0));
+    }
+
+    T next() {
+        T v;
+        render(std::span(&v, 1));
+        return v;
     }
 
     T operator()() { return next(); }
@@ -9,6 +9,9 @@
 #include <cmath>
 #include <numbers>
 #include <iostream>
+#include <concepts>
+#include <complex>
+#include <limits>
 
 #include "generator.hpp"
 
@@ -28,9 +31,9 @@ struct Modem {
     virtual std::function<float(int)> encode(Symbol symbol) = 0;
     virtual Symbol decode(std::span<float>) = 0;
 
-    Generator<float> create(Symbol symbol) {
+    virtual Generator<float> create(Symbol symbol) {
         // std::cout << "(Sender) Create symbol " << (int)symbol << '\n';
-        return { encode(symbol), symbol_duration, "Symbol " + std::to_string(symbol) };
+        return { encode(symbol), symbol_duration, "Symbol" };
     }
 
     virtual void symbol_to_bits(Symbol symbol, std::vector<bool> &bits) = 0;
@@ -43,7 +46,15 @@ struct Modem {
     }
     Generator<float> create_data_end() {
         // stop for two symbol_duration
-        return { [](int) {return 0.f;}, symbol_duration * 3, "Data End" };
+        return { SilenceBlock<float> {}, symbol_duration * 3, "Data End" };
+    }
+
+    // a known symbol the sender puts after every pilot_interval() data symbols, 0 for none
+    virtual int pilot_interval() {
+        return 0;
+    }
+    virtual Generator<float> create_pilot() {
+        return create_calibrate();
     }
 
     enum class SymbolType {
@@ -67,14 +78,37 @@ struct Modem {
 
 };
 
-class FreqModem : public Modem {
+// what Sender and Receiver need from a modem
+// the concrete modems are final, so Sender<P, QAMModem> calls them without virtual dispatch,
+// while Sender<P, Modem> keeps choosing the modem at runtime
+template<typename T>
+concept ModemConcept = requires(T &modem, typename T::Symbol symbol, std::span<float> y, std::vector<bool> &bits) {
+    { modem.symbol_duration } -> std::convertible_to<int>;
+    { modem.decode(y) } -> std::convertible_to<typename T::Symbol>;
+    { modem.create(symbol) } -> std::same_as<Generator<float>>;
+    { modem.create_calibrate() } -> std::same_as<Generator<float>>;
+    { modem.create_data_end() } -> std::same_as<Generator<float>>;
+    { modem.pilot_interval() } -> std::convertible_to<int>;
+    { modem.create_pilot() } -> std::same_as<Generator<float>>;
+    { modem.symbol_type(symbol) } -> std::same_as<Modem::SymbolType>;
+    { modem.symbol_to_bits(symbol, bits) };
+    { modem.bits_to_symbols(bits) } -> std::convertible_to<std::vector<typename T::Symbol>>;
+    { modem.reset() };
+};
+
+class FreqModem final : public Modem {
 
     std::vector<float> omegas;
+    std::vector<std::vector<float>> carriers;   // sin table of each frequency
 
 public:
 
     FreqModem(std::vector<float> omegas, int symbol_duration)
         : Modem(symbol_duration, 1 << omegas.size()), omegas(omegas) {
+        for (auto omega : omegas) {
+            carriers.emplace_back(symbol_duration);
+            Signals::NCO(omega).render_sin(carriers.back());
+        }
         std::cout << "(Receiver) Set Symbol Frequncies: [";
         for (auto f : omegas)
             std::cout << f << ", ";
@@ -125,13 +159,12 @@ public:
         if (symbol > symbol_count)
             throw std::runtime_error("Error: symbol out of range");
 
-        return [symbol, omegas = this->omegas](int i) {
+        return [&, symbol](int i) {
             float v = 0;
-            for (int j = 0; j < omegas.size(); j++)
+            for (int j = 0; j < carriers.size(); j++)
                 if (symbol & (1 << j))
-                    v += std::sin(2 * std::numbers::pi * omegas[j] * i);
-            // v += std::sin(2 * std::numbers::pi * omegas[omegas.size()-1] * i);
-            return v / omegas.size();
+                    v += carriers[j][i];
+            return v / carriers.size();
         };
     }
 
@@ -173,7 +206,7 @@ public:
 
 };
 
-struct PhaseModem : Modem {
+struct PhaseModem final : Modem {
 
     // struct Symbol {
     //     uint8_t data;
@@ -200,12 +233,19 @@ struct PhaseModem : Modem {
     // encode data to sin waves
     std::vector<float> omegas;
     std::vector<float> phases;
+    std::vector<std::vector<float>> carrier_sin, carrier_cos;   // tables of each frequency
 
     PhaseModem(std::vector<float> omegas, std::vector<float> phases, int symbol_duration)
         : Modem(symbol_duration, std::pow(phases.size(), omegas.size())),
         omegas(omegas),
         phases(phases)
     {
+        for (auto omega : omegas) {
+            auto [c, s] = Signals::NCO::table(omega, symbol_duration);
+            carrier_cos.push_back(std::move(c));
+            carrier_sin.push_back(std::move(s));
+        }
+
         std::cout << "Set Symbol Frequncies:\n [";
         for (auto f : omegas)
             std::cout << f << ", ";
@@ -246,18 +286,20 @@ struct PhaseModem : Modem {
         if (symbol > symbol_count)
             throw std::runtime_error("Error: symbol out of range");
 
-        std::vector<std::pair<float, float>> omega_phase_pairs;
+        // sin(wt + p) = sin(wt) cos(p) + cos(wt) sin(p)
+        std::vector<std::pair<float, float>> weights;
         for (int i = 0; i < omegas.size() - 1; i++) {
-            omega_phase_pairs.emplace_back(omegas[i], phases[symbol % phases.size()]);
+            auto phase = phases[symbol % phases.size()];
+            weights.emplace_back(std::cos(phase), std::sin(phase));
             symbol /= phases.size();
         }
-        omega_phase_pairs.emplace_back(omegas.back(), 0.f);
+        weights.emplace_back(1.f, 0.f);
 
-        return [omega_phase_pairs](int i) {
+        return [&, weights](int i) {
             float v = 0;
-            for (const auto &[omega, phase] : omega_phase_pairs)
-                v += std::sin(2 * std::numbers::pi * omega * i + phase);
-            v /= omega_phase_pairs.size();
+            for (int j = 0; j < weights.size(); j++)
+                v += weights[j].first * carrier_sin[j][i] + weights[j].second * carrier_cos[j][i];
+            v /= weights.size();
             return v;
         };
     }
@@ -272,10 +314,10 @@ struct PhaseModem : Modem {
 
         auto c = std::valarray<float>(omegas.size());
         for (int i = 0; i < omegas.size(); i++) {
-            auto omega = omegas[i];
+            const auto &carrier = carrier_sin[i];
             c[i] = 0;
             for (int j = 0; j < n; j++)
-                c[i] += std::sin(2 * std::numbers::pi * omega * j) * y[j];
+                c[i] += carrier[j] * y[j];
         }
         c /= -c[c.size() - 1];
         c -= c[c.size() - 1];
@@ -292,17 +334,35 @@ struct PhaseModem : Modem {
 
 };
 
-class SimpleModem : public Modem {
+class SimpleModem final : public Modem {
 
+public:
+    // Coherent learns the polarity from the calibrate symbol, the differential modes
+    // carry the bits in the phase change between symbols, so the calibrate symbol is
+    // only the phase reference and a polarity flip or phase slip costs one symbol
+    enum class Mode {
+        Coherent,
+        DBPSK,
+        DQPSK,
+    };
+
+private:
     int carrierSize;
+    Mode mode;
 
     std::vector<float> carrier_sin, carrier_cos;
     #ifdef LOG
         std::ofstream ofile { "SimpleModem.txt" };
     #endif
+
+    // phase change of a differential symbol in quarter turns, Gray coded for DQPSK
+    int quarter_turns(Symbol symbol) const {
+        return mode == Mode::DBPSK ? symbol * 2 : symbol ^ (symbol >> 1);
+    }
+
 public:
-    SimpleModem(int carrierSize)
-        : Modem(carrierSize, 2), carrierSize(carrierSize) {
+    SimpleModem(int carrierSize, Mode mode = Mode::Coherent)
+        : Modem(carrierSize, mode == Mode::DQPSK ? 4 : 2), carrierSize(carrierSize), mode(mode) {
         carrier_sin.reserve(carrierSize);
         carrier_cos.reserve(carrierSize);
         for (int i = 0; i < carrierSize; i++) {
@@ -318,14 +378,44 @@ public:
             return [&](int i) { return -carrier_sin[i]; };
     }
 
+    // sender side phase of the differential modes, in quarter turns since the reference
+    int tx_phase = 0;
+
+    Generator<float> create(Symbol symbol) override {
+        if (mode == Mode::Coherent)
+            return { ToneBlock<float> { carrier_sin, symbol == 0 ? 1.f : -1.f }, carrierSize, "Symbol" };
+        tx_phase = (tx_phase + quarter_turns(symbol)) % 4;
+        constexpr std::complex<float> turns[] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+        // sin(wt + phase) = cos(phase) sin(wt) + sin(phase) cos(wt)
+        return { SymbolBlock<float> { carrier_sin, carrier_cos, turns[tx_phase] }, carrierSize, "Symbol" };
+    }
+
     std::optional<int> k;
+    std::optional<std::complex<float>> last;    // previous symbol of the differential modes
     Symbol decode(std::span<float> data) override {
-        float sum = 0;
+        float sum = 0, sum_cos = 0;
         for (auto i = 0; i < data.size(); i++) {
             #ifdef LOG
                 ofile << data[i] << '\n';
             #endif
             sum += data[i] * carrier_sin[i];
+            sum_cos += data[i] * carrier_cos[i];
+        }
+
+        if (mode != Mode::Coherent) {
+            auto z = std::complex<float>(sum, sum_cos);
+            if (!last) {
+                last = z;
+                return -1;
+            }
+            if (std::abs(z) < 0.01)
+                return -2;
+            auto change = std::arg(z * std::conj(*last));
+            last = z;
+            if (mode == Mode::DBPSK)
+                return std::abs(change) > std::numbers::pi / 2;
+            auto q = (int(std::round(change / (std::numbers::pi / 2))) + 4) % 4;
+            return q ^ (q >> 1);
         }
 
         if (!k) {
@@ -342,9 +432,17 @@ public:
     }
 
     void symbol_to_bits(Symbol symbol, std::vector<bool> &bits) override {
-        bits.push_back(symbol);
+        bits.push_back(symbol & 1);
+        if (mode == Mode::DQPSK)
+            bits.push_back(symbol >> 1);
     }
     std::vector<Symbol> bits_to_symbols(const std::vector<bool> &bits) override {
+        if (mode == Mode::DQPSK) {
+            std::vector<Symbol> symbols((bits.size() + 1) / 2);
+            for (int i = 0; i < bits.size(); i++)
+                symbols[i / 2] |= bits[i] << (i % 2);
+            return symbols;
+        }
         std::vector<Symbol> symbols(bits.size());
         for (int i = 0; i < bits.size(); i++)
             symbols[i] = bits[i];
@@ -352,68 +450,136 @@ public:
     }
 
     Generator<float> create_calibrate() override {
+        if (mode != Mode::Coherent) {
+            // the phase reference of the packet
+            tx_phase = 0;
+            return { ToneBlock<float> { carrier_sin }, carrierSize, "Modem Reference" };
+        }
         return create(0);
     }
 
     void reset() override {
         k = {};
+        last = {};
     }
 
 };
 
-struct QAMModem : Modem {
+struct QAMModem final : Modem {
 
     float omega;
     int order;
+    int bits_per_axis;
     std::vector<std::complex<float>> symbols;
+    std::complex<float> pilot;
+    float mean_power = 0;
     Signals::Butter<float> butter;
+    std::vector<float> carrier_cos, carrier_sin;
+    std::optional<Signals::Equalizer<float>> equalizer;
+    static constexpr int training_passes = 16;  // the calibrate symbol is short, reuse it until the taps settle
+
+    int pilot_every;
+    float tracking_gain, pilot_gain;
 
     #ifdef LOG
         std::ofstream ofile { "QAM.txt" };
     #endif
 
+    static int gray(int l) { return l ^ (l >> 1); }
+    static int gray_inverse(int g) {
+        int l = 0;
+        for (; g; g >>= 1)
+            l ^= g;
+        return l;
+    }
+
+    // amplitude of level l on one axis, the corners of the grid sit on the unit circle
+    float level(int l) const {
+        return (2.f * l / (order - 1) - 1) / std::sqrt(2.f);
+    }
+
 public:
 
     struct Config {
         float omega;
         int duration;
         Signals::Butter<float> butter;
-        int order = 2;
+        int order = 2;              // points per axis, 4 and 8 give 16-QAM and 64-QAM
+        int equalizer_taps = 0;     // 0 to disable the equalizer
+        float equalizer_mu = 0.05;
+        int pilot_interval = 0;     // data symbols between pilots, 0 for none
+        float tracking_gain = 0.05; // decision directed phase/gain loop
+        float pilot_gain = 0.5;
     };
 
     QAMModem(Config config)
-        : QAMModem(config.omega, config.duration, config.butter, config.order) { }
-
-    QAMModem(float omega, int duration, Signals::Butter<float> butter, int order = 2)
-        : Modem(duration, order *order), omega(omega), order(order), symbols([](int order) {
-            if (order > 1) {
-                auto phase = std::vector<std::complex<float>>(order * order);
-                for (int i = 0; i < order; i++)
-                    for (int j = 0; j < order; j++) {
-                        phase[i * order + j] = std::complex<float>(
-                            (2. * j / (order - 1) - 1),
-                            (2. * i / (order - 1) - 1)
-                        ) / std::sqrt(2.f);
-                        std::cout << i * order + j << " (" << phase[i * order + j].real() << ", " << phase[i * order + j].imag() << ")\n";
-                    }
-                return phase;
-            }
-            else {
-                return std::vector<std::complex<float>> { 1, -1 };
-            }
-        }(order)), butter(butter) { }
+        : QAMModem(config.omega, config.duration, config.butter, config.order, config.equalizer_taps, config.equalizer_mu) {
+        pilot_every = config.pilot_interval;
+        tracking_gain = config.tracking_gain;
+        pilot_gain = config.pilot_gain;
+    }
+
+    QAMModem(float omega, int duration, Signals::Butter<float> butter, int order = 2, int equalizer_taps = 0, float equalizer_mu = 0.05)
+        : Modem(duration, order * order), omega(omega), order(order), bits_per_axis(std::log2(order)), butter(butter),
+          pilot_every(0), tracking_gain(0.05), pilot_gain(0.5) {
+        if (order > 1) {
+            // Gray mapping on each axis, the low bits pick the in-phase level and the high bits the quadrature one
+            // so neighbouring points differ in one bit
+            if (order & (order - 1))
+                throw std::runtime_error("Error: QAM order must be a power of two");
+            symbols.resize(order * order);
+            for (int s = 0; s < order * order; s++)
+                symbols[s] = { level(gray_inverse(s & (order - 1))), level(gray_inverse(s >> bits_per_axis)) };
+            pilot = { level(order - 1), level(order - 1) };
+        }
+        else {
+            symbols = { 1, -1 };
+            pilot = 1;
+        }
+        for (auto p : symbols)
+            mean_power += std::norm(p) / symbols.size();
+        std::tie(carrier_cos, carrier_sin) = Signals::NCO::table(omega, duration);
+        if (equalizer_taps > 0)
+            equalizer.emplace(equalizer_taps, equalizer_mu);
+    }
+
+    // the waveform a constellation point is sent as, used as the equalizer reference
+    std::vector<float> reference(std::complex<float> point) const {
+        std::vector<float> r(carrier_cos.size());
+        SymbolBlock<float> { carrier_cos, carrier_sin, point }.render(r, 0);
+        return r;
+    }
 
 
+    // order 1 is BPSK, two points for a symbol_count of one
     std::function<float(int)> encode(Symbol symbol) override {
-        if (symbol > symbol_count)
+        if (symbol >= symbols.size())
             throw std::runtime_error("Error: symbol out of range");
-        return [omega = this->omega, phase = symbols[symbol]](int i) {
-            auto p = 2 * std::numbers::pi * omega * i;
-            return float(phase.real() * std::cosf(p) + phase.imag() * std::sinf(p));
+        return [&, phase = symbols[symbol]](int i) {
+            return phase.real() * carrier_cos[i] + phase.imag() * carrier_sin[i];
         };
     }
 
+    Generator<float> create(Symbol symbol) override {
+        if (symbol >= symbols.size())
+            throw std::runtime_error("Error: symbol out of range");
+        return { SymbolBlock<float> { carrier_cos, carrier_sin, symbols[symbol] }, symbol_duration, "Symbol" };
+    }
+
+    int pilot_interval() override {
+        return pilot_every;
+    }
+
+    Generator<float> create_pilot() override {
+        return { SymbolBlock<float> { carrier_cos, carrier_sin, pilot }, symbol_duration, "Pilot" };
+    }
+
     std::optional<int> phase_offset;
+    std::complex<float> track = 1;  // residual phase and gain correction, follows the channel within a packet
+    float phase_step = 0;           // phase drift per symbol
+    float noise_variance = 0.1;     // of the corrected points, drives the LLR scale
+    int symbol_index = 0;           // symbols decoded since calibrate, pilots included
+    std::vector<float> llrs;        // soft bits of the last data symbol, log P(0) / P(1)
 
 
     float standard_amplitude = 1;
@@ -422,6 +588,14 @@ public:
         auto filtered = butter.filter(y);
         // auto filtered = y;
 
+        if (equalizer) {
+            // the calibrate symbol is the training sequence, later symbols adapt on decisions
+            equalizer->push(filtered);
+            if (!phase_offset)
+                equalizer->train(carrier_cos, training_passes);
+            filtered = equalizer->output();
+        }
+
         #ifdef LOG
             for (auto i = 0; i < filtered.size(); i++)
                 ofile << filtered[i] << '\n';
@@ -432,6 +606,7 @@ public:
         // auto i_begin = 0;
         // auto i_end = y.size();
         i_end = std::min(i_end, filtered.size());
+        i_end = std::min(i_end, carrier_cos.size());
 
         int offset = 0;
         if (phase_offset)
@@ -439,8 +614,8 @@ public:
 
         float a = 0, b = 0;
         for (auto i = i_begin; i < i_end; i++) {
-            a += filtered[i + offset] * std::cosf(2 * std::numbers::pi * omega * i);
-            b += filtered[i + offset] * std::sinf(2 * std::numbers::pi * omega * i);
+            a += filtered[i + offset] * carrier_cos[i];
+            b += filtered[i + offset] * carrier_sin[i];
         }
 
         a /= i_end - i_begin;
@@ -453,44 +628,97 @@ public:
             if (phase < 0)
                 phase += 2 * std::numbers::pi;
             phase_offset = int(std::round(phase / (2 * std::numbers::pi * omega)));
+            if (equalizer)
+                phase_offset = 0;   // the equalizer is trained on the aligned reference
+            // the sample offset only gets within half a sample, the loop takes the rest
+            track = std::polar(1.f, float(2 * std::numbers::pi * omega * *phase_offset - phase));
+            if (equalizer)
+                track = 1;
+            phase_step = 0;
+            symbol_index = 0;
             // std::cout << "(Receiver) Set offset: " << *phase_offset << '\n';
             return -1;
         }
 
-        a /= standard_amplitude;
-        b /= standard_amplitude;
+        // carry the phase ramp of a sample clock offset over to this symbol
+        track *= std::polar(1.f, phase_step);
+        auto z = std::complex<float>(a, b) / standard_amplitude;
+        auto point = z * track;
 
         // if (phase_offset.has_value()) 
-        //     std::cout << "(Receiver) Decoding: (" << a << ", " << b << ")" << '\n';
+        //     std::cout << "(Receiver) Decoding: (" << point.real() << ", " << point.imag() << ")" << '\n';
 
-        int i, j;
+        if (pilot_every > 0 && ++symbol_index % (pilot_every + 1) == 0) {
+            adapt(z, point, pilot, pilot_gain);
+            return -1;
+        }
 
+        Symbol symbol;
         if (order == 1) {
-            return a < 0;
-        }
-        else if (order == 2) {
-            if (a < 0 && b < 0)
-                i = 0, j = 0;
-            else if (a < 0 && b > 0)
-                i = 0, j = 1;
-            else if (a > 0 && b < 0)
-                i = 1, j = 0;
-            else if (a > 0 && b > 0)
-                i = 1, j = 1;
+            symbol = point.real() < 0;
         }
         else {
-            a *= std::sqrt(2);
-            b *= std::sqrt(2);
-            i = std::round((a + 1) * (order - 1) / 2);
-            j = std::round((b + 1) * (order - 1) / 2);
+            // nearest level on each axis
+            auto axis = [&](float x) {
+                return std::clamp<int>(std::round((x * std::sqrt(2.f) + 1) * (order - 1) / 2), 0, order - 1);
+            };
+            symbol = gray(axis(point.real())) | gray(axis(point.imag())) << bits_per_axis;
+        }
+
+        soft_decision(point);
+        adapt(z, point, symbols[symbol], tracking_gain);
+        return symbol;
+    }
+
+    // one step of the phase/gain loop towards the decided (or known) point
+    // second order: the phase error also trims the per symbol rotation
+    void adapt(std::complex<float> z, std::complex<float> point, std::complex<float> decided, float gain) {
+        auto error = decided - point;
+        noise_variance += 0.05f * (std::norm(error) - noise_variance);
+        if (std::norm(z) > 1e-6f && std::norm(point) > 1e-6f) {
+            track += gain * error * std::conj(z) / std::norm(z);
+            phase_step += gain * gain / 2 * std::arg(decided / point);
         }
+        if (equalizer)
+            equalizer->train(reference(decided));
+    }
+
+    // max-log LLRs, the axes are independent so each bit only looks at its own axis
+    void soft_decision(std::complex<float> point) {
+        llrs.clear();
+        auto scale = 1 / std::max(noise_variance, 1e-6f);
+        auto axis = [&](float x, int levels) {
+            for (int k = 0; k < bits_per_axis; k++) {
+                float d0 = std::numeric_limits<float>::max(), d1 = d0;
+                for (int l = 0; l < levels; l++) {
+                    auto d = (x - level(l)) * (x - level(l));
+                    auto &best = (gray(l) >> k) & 1 ? d1 : d0;
+                    best = std::min(best, d);
+                }
+                llrs.push_back((d1 - d0) * scale);
+            }
+        };
+        if (order == 1) {
+            llrs.push_back(4 * point.real() * scale);
+            return;
+        }
+        axis(point.real(), order);
+        axis(point.imag(), order);
+    }
+
+    // append the LLRs of the last data symbol, in the order symbol_to_bits appends the bits
+    void symbol_to_llrs(std::vector<float> &out) const {
+        out.insert(out.end(), llrs.begin(), llrs.end());
+    }
 
-        return i + j * order;
+    // signal to noise ratio measured on the decided points
+    float snr_db() const {
+        return 10 * std::log10(mean_power / std::max(noise_variance, 1e-6f));
     }
 
 
     virtual Generator<float> create_calibrate() override {
-        return { [omega = this->omega](int i) { return std::cosf(2 * std::numbers::pi * omega * i); }, symbol_duration, "Modem Calibrate" };
+        return { ToneBlock<float> { carrier_cos }, symbol_duration, "Modem Calibrate" };
     }
 
 
@@ -528,11 +756,16 @@ public:
 
     void reset() override {
         phase_offset = {};
+        track = 1;
+        phase_step = 0;
+        symbol_index = 0;
+        if (equalizer)
+            equalizer->reset();
     }
 
 };
 
-struct DigitalModem : Modem {
+struct DigitalModem final : Modem {
 
     // no modulation, just send bits
     DigitalModem(int symbol_duration) : Modem(symbol_duration, 3) { }
@@ -560,7 +793,7 @@ struct DigitalModem : Modem {
 
     Generator<float> create_calibrate() override {
         /// Maybe implemented later
-        return { [](int i) { return 0.f; }, 0, "Modem Calibrate" };
+        return { SilenceBlock<float> {}, 0, "Modem Calibrate" };
     }
 
 };
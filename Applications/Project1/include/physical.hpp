@@ -43,8 +43,8 @@ namespace Physical {
     class BitStreamDeviceIOHandler : public std::enable_shared_from_this<BitStreamDeviceIOHandler<PreambleType, ModemType>>, public IOHandler<float> {
 
         BitStreamDeviceConfig<PreambleType, ModemType> config;
-        Sender sender { config.modem, config.preamble, config.package_size};
-        Receiver receiver { config.modem, config.preamble, config.package_size };
+        Sender<PreambleType, ModemType> sender { config.modem, config.preamble, config.package_size};
+        Receiver<PreambleType, ModemType> receiver { config.modem, config.preamble, config.package_size };
 
         bool running = false;
 
@@ -7,6 +7,7 @@
 #include <deque>
 #include <numeric>
 #include <ranges>
+#include <concepts>
 
 #include "utils.hpp"
 #include "device.hpp"
@@ -19,11 +20,19 @@ struct Preamble {
     virtual std::optional<int> wait(const DataView<float> &p) noexcept = 0;
 };
 
-struct SinePreamble : Preamble {
+template<typename T>
+concept PreambleConcept = requires(T &preamble, const DataView<float> &p) {
+    { preamble.create() } -> std::same_as<Generator<float>>;
+    { preamble.calibrate(p) } -> std::convertible_to<bool>;
+    { preamble.wait(p) } -> std::same_as<std::optional<int>>;
+};
+
+struct SinePreamble final : Preamble {
     float omega;
     int duration;
     Signals::Butter<float> butter;
     std::vector<float> buffer;
+    std::vector<float> signal;
 
     std::ofstream ofile { "out.txt" };
 
@@ -34,11 +43,13 @@ struct SinePreamble : Preamble {
         Signals::Butter<float> butter;
     };
 
-    SinePreamble(Config config) : omega(config.omega), duration(config.duration), butter(config.butter) { }
+    SinePreamble(Config config) : omega(config.omega), duration(config.duration), butter(config.butter), signal(config.duration) {
+        Signals::NCO(omega).render_sin(signal);
+    }
 
     Generator<float> create() noexcept override {
         return Generator<float>(
-            [omega=this->omega](int i) { return std::sinf(2 * std::numbers::pi * omega * i); },
+            PreambleBlock<float> { signal },
             duration,
             "Preamble"
         );
@@ -91,20 +102,13 @@ struct SinePreamble : Preamble {
 
 };
 
-struct StaticPreamble : Preamble {
+struct StaticPreamble final : Preamble {
     std::vector<float> signal;
     float threshold;
-    StaticPreamble(std::string path, float threshold) : signal([](std::string path) {
-        std::ifstream file {path};
-        std::vector<float> signal;
-        float sample;
-        while (file >> sample)
-            signal.push_back(sample);
-        return signal;
-    }(path)),  threshold(threshold) { }
+    StaticPreamble(std::string path, float threshold) : signal(utils::from_file<float>(path)), threshold(threshold) { }
     Generator<float> create() noexcept override {
         return Generator<float>(
-            [&](int i) { return signal[i]; },
+            PreambleBlock<float> { signal },
             signal.size(),
             "Preamble"
         );
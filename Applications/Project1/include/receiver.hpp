@@ -10,6 +10,7 @@
 
 namespace Physical {
 
+template<PreambleConcept PreambleType = Preamble, ModemConcept ModemType = Modem>
 class Receiver {
     enum class State {
         Calibrating,
@@ -21,11 +22,12 @@ class Receiver {
     } state = State::Calibrating;
     
     std::vector<bool> inputBits;
+    std::vector<float> inputLLRs;   // soft bits alongside inputBits, for modems that provide them
 
     std::vector<float> inputBuffer; // the buffer to store signal for symbol decoding
 
-    Modem &modem;
-    Preamble &preamble;
+    ModemType &modem;
+    PreambleType &preamble;
 
     #ifdef LOG
         std::ofstream ofile { "receiver.log" };
@@ -35,7 +37,7 @@ class Receiver {
 
 public:
 
-    Receiver(Modem &modem, Preamble &preamble, int package_size) : modem(modem), preamble(preamble), package_size(package_size) {}
+    Receiver(ModemType &modem, PreambleType &preamble, int package_size) : modem(modem), preamble(preamble), package_size(package_size) {}
 
     bool available() {
         return !inputBits.empty();
@@ -46,6 +48,11 @@ public:
         return std::move(inputBits);
     }
 
+    // clear inputLLRs and return the soft bits of the data read so far
+    std::vector<float> read_llrs() {
+        return std::move(inputLLRs);
+    }
+
     int cur_package_index = 0;
     void handleCallback(const DataView<float> &p) noexcept {
 
@@ -71,74 +78,13 @@ public:
                     // std::cout << "(Receiver) Preamble end at " << *start << '\n';
                     state = State::FetchingData;
                     inputBuffer.clear();
-                    for (int i = *start; i < std::min(
-                        modem.symbol_duration - 
-                        int(inputBuffer.size()),
-                        int(p.getNumSamples())
-                    ); i++) {
-                        inputBuffer.push_back(p(0, i));
-                    }
+                    // the first symbol starts right after the preamble, in this block
+                    fetch(p, *start);
                 }
                 break;
                 
             case State::FetchingData:
-                {
-                    int i_start = 0;
-
-                    while (true) {
-
-                        int i_max = std::min(
-                            modem.symbol_duration - inputBuffer.size() + i_start,
-                            p.getNumSamples()
-                        );
-                        
-                        for (int i = i_start; i < i_max; i++)
-                            inputBuffer.push_back(p(0, i));
-
-                        if (inputBuffer.size() > modem.symbol_duration) {
-                            // std::cerr << "(Receiver) Error: inputBuffer overflow" << '\n';
-                            exit(-1);
-                        } else if (inputBuffer.size() == modem.symbol_duration) {
-                            Modem::Symbol symbol = modem.decode(inputBuffer);
-                            // handle symbol 
-                            switch (modem.symbol_type(symbol)) {
-                                case Modem::SymbolType::Data:
-                                    // std::cout << "(Receiver) Data symbol: " << (int)symbol << '\n';
-
-                                    // transform symbol to bits and extend inputBits
-                                    modem.symbol_to_bits(symbol, inputBits);
-
-                                    if (++cur_package_index == package_size) {
-                                        // std::cout << "(Receiver) Package finished" << '\n';
-                                        cur_package_index = 0;
-                                        state = State::Idle;
-                                    }
-                                    break;
-                                case Modem::SymbolType::Stop:
-                                    // std::cout << "(Receiver) Stop symbol " << (int)symbol << '\n';
-                                    state = State::Idle;
-                                    break;
-                                case Modem::SymbolType::Error:
-                                    // std::cerr << "(Receiver) Error symbol: " << (int)symbol << '\n';
-                                    break;
-                                case Modem::SymbolType::Pass:
-                                    // std::cout << "(Receiver) Pass symbol" << '\n';
-                                    break;
-                            }
-
-                            inputBuffer.clear();
-                            i_start = i_max;
-
-                            if (state != State::FetchingData)
-                                break;
-                            
-                        } else {
-                            break;
-                            
-                        }
-                        
-                    }
-                }
+                fetch(p, 0);
                 break;
             case State::Stop:
                 break;
@@ -146,6 +92,67 @@ public:
     
     }
 
+private:
+
+    // cut p from i_start into symbols and decode them until the block or the packet ends
+    void fetch(const DataView<float> &p, int i_start) {
+        while (true) {
+
+            int i_max = std::min(
+                modem.symbol_duration - inputBuffer.size() + i_start,
+                p.getNumSamples()
+            );
+            
+            for (int i = i_start; i < i_max; i++)
+                inputBuffer.push_back(p(0, i));
+
+            if (inputBuffer.size() > modem.symbol_duration) {
+                // std::cerr << "(Receiver) Error: inputBuffer overflow" << '\n';
+                exit(-1);
+            } else if (inputBuffer.size() == modem.symbol_duration) {
+                typename ModemType::Symbol symbol = modem.decode(inputBuffer);
+                // handle symbol 
+                switch (modem.symbol_type(symbol)) {
+                    case ModemType::SymbolType::Data:
+                        // std::cout << "(Receiver) Data symbol: " << (int)symbol << '\n';
+
+                        // transform symbol to bits and extend inputBits
+                        modem.symbol_to_bits(symbol, inputBits);
+                        if constexpr (requires { modem.symbol_to_llrs(inputLLRs); })
+                            modem.symbol_to_llrs(inputLLRs);
+
+                        if (++cur_package_index == package_size) {
+                            // std::cout << "(Receiver) Package finished" << '\n';
+                            cur_package_index = 0;
+                            state = State::Idle;
+                        }
+                        break;
+                    case ModemType::SymbolType::Stop:
+                        // std::cout << "(Receiver) Stop symbol " << (int)symbol << '\n';
+                        state = State::Idle;
+                        break;
+                    case ModemType::SymbolType::Error:
+                        // std::cerr << "(Receiver) Error symbol: " << (int)symbol << '\n';
+                        break;
+                    case ModemType::SymbolType::Pass:
+                        // std::cout << "(Receiver) Pass symbol" << '\n';
+                        break;
+                }
+
+                inputBuffer.clear();
+                i_start = i_max;
+
+                if (state != State::FetchingData)
+                    break;
+                
+            } else {
+                break;
+                
+            }
+            
+        }
+    }
+
 };
 
 
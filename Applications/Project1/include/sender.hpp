@@ -9,27 +9,29 @@
 
 namespace Physical {
 
+template<PreambleConcept PreambleType = Preamble, ModemConcept ModemType = Modem>
 class Sender {
 
     GeneratorQueue<float> outputGenerator;
-    std::mutex generator_mutex;
-    Modem& modem;
-    Preamble& preamble;
+    std::mutex send_mutex;  // serializes producers, never taken by the audio thread
+    ModemType& modem;
+    PreambleType& preamble;
     #ifdef LOG
         std::ofstream ofile { "sender.log" };
     #endif
     int package_size;
+    std::vector<float> outputBuffer;
 
 public:
 
-    Sender(Modem &modem, Preamble& preamble, int package_size)
+    Sender(ModemType &modem, PreambleType& preamble, int package_size)
             : modem(modem), preamble(preamble), package_size(package_size) {}
 
     void send(const std::vector<bool> &data) {
-        std::lock_guard<std::mutex> lock(generator_mutex);
+        std::lock_guard<std::mutex> lock(send_mutex);
         
         int cur_package_index = 0;
-        for (Modem::Symbol symbol: modem.bits_to_symbols(data)) {
+        for (typename ModemType::Symbol symbol: modem.bits_to_symbols(data)) {
             if (cur_package_index == package_size) {
                 outputGenerator.push(modem.create_data_end());
                 cur_package_index = 0;
@@ -38,6 +40,8 @@ public:
                 outputGenerator.push(preamble.create());
                 outputGenerator.push(modem.create_calibrate());
             }
+            else if (modem.pilot_interval() > 0 && cur_package_index % modem.pilot_interval() == 0)
+                outputGenerator.push(modem.create_pilot());
             outputGenerator.push(modem.create(symbol));
             cur_package_index++;
         }
@@ -47,14 +51,13 @@ public:
     }
 
     void handleCallback(DataView<float> &p) noexcept {
-        
-        std::lock_guard<std::mutex> lock(generator_mutex);
+        outputBuffer.resize(p.getNumSamples());
+        outputGenerator.render(outputBuffer);
         for (auto i = 0; i < p.getNumSamples(); i++) {
-            float y = outputGenerator();
-            p(0, i) = y;
-            p(1, i) = y;
+            p(0, i) = outputBuffer[i];
+            p(1, i) = outputBuffer[i];
             #ifdef LOG
-                ofile << y << std::endl;
+                ofile << outputBuffer[i] << std::endl;
             #endif
         }
     }
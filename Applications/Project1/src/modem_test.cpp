@@ -0,0 +1,116 @@
+#include "physical.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// modems back to back without a channel, every test prints PASS or FAIL
+// and the exit code counts the failures
+
+using namespace Physical;
+
+int failures = 0;
+
+void check(bool ok, const char *name) {
+    std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    failures += !ok;
+}
+
+std::vector<float> render(Generator<float> gen) {
+    std::vector<float> out(gen.size());
+    gen.render(out);
+    return out;
+}
+
+// the modem from Project1's main: order 1 is BPSK
+void test_qam_bpsk_round_trip() {
+    QAMModem modem { {
+        .omega = 2400. / 48000.,
+        .duration = 600,
+        .butter = {
+            { 0.00016822370859146914, 0.0, -0.0003364474171829383, 0.0, 0.00016822370859146914},
+            { 1.0, -3.76934096654668, 5.515261708905102, -3.7001989105751507, 0.9636529842237052}
+        },
+        .order = 1,
+    } };
+
+    std::mt19937 rng(1);
+    std::vector<bool> bits(64);
+    for (auto &&b : bits)
+        b = rng() & 1;
+
+    std::vector<float> signal = render(modem.create_calibrate());
+    bool encoded = true;
+    try {
+        for (auto symbol : modem.bits_to_symbols(bits)) {
+            auto samples = render(modem.create(symbol));
+            signal.insert(signal.end(), samples.begin(), samples.end());
+        }
+    } catch (const std::runtime_error &) {
+        encoded = false;
+    }
+    check(encoded, "QAMModem order 1 encodes both symbols");
+
+    std::vector<bool> decoded;
+    for (size_t i = 0; i + modem.symbol_duration <= signal.size(); i += modem.symbol_duration) {
+        auto symbol = modem.decode(std::span(signal).subspan(i, modem.symbol_duration));
+        if (modem.symbol_type(symbol) == Modem::SymbolType::Data)
+            modem.symbol_to_bits(symbol, decoded);
+    }
+    check(decoded == bits, "QAMModem order 1 round trip");
+}
+
+// a packet starts at the first sample, so the test drives Receiver without a real preamble
+struct ImmediatePreamble {
+    bool started = false;
+    Generator<float> create() { return {}; }
+    bool calibrate(const DataView<float> &) { return true; }
+    std::optional<int> wait(const DataView<float> &) {
+        if (started)
+            return std::nullopt;
+        started = true;
+        return 0;
+    }
+};
+
+// the differential modes decode the reference symbol as -1 and a faded symbol as -2,
+// Receiver has to take them as Pass and Stop and never append them as bits
+void test_differential_receiver(SimpleModem::Mode mode, const char *name) {
+    SimpleModem modem(48, mode);
+    ImmediatePreamble preamble;
+    Receiver<ImmediatePreamble, SimpleModem> receiver(modem, preamble, 1 << 10);
+
+    std::mt19937 rng(2);
+    std::vector<bool> bits(64);
+    for (auto &&b : bits)
+        b = rng() & 1;
+
+    // reference, data, then two silent symbols for the stop
+    std::vector<float> signal = render(modem.create_calibrate());
+    for (auto symbol : modem.bits_to_symbols(bits)) {
+        auto samples = render(modem.create(symbol));
+        signal.insert(signal.end(), samples.begin(), samples.end());
+    }
+    signal.resize(signal.size() + modem.symbol_duration * 2);
+
+    std::vector<int> samples(signal.size());
+    for (size_t i = 0; i < signal.size(); i++)
+        samples[i] = int(signal[i] * (1 << 30));
+
+    // blocks that do not line up with the symbols
+    int *channel = samples.data();
+    receiver.handleCallback(DataView<float>(&channel, 1, 0, 48000));    // calibrate
+    for (size_t i = 0; i < samples.size(); i += 100) {
+        channel = samples.data() + i;
+        receiver.handleCallback(DataView<float>(&channel, 1, std::min<int>(100, samples.size() - i), 48000));
+    }
+    check(receiver.read() == bits, name);
+}
+
+int main() {
+    test_qam_bpsk_round_trip();
+    test_differential_receiver(SimpleModem::Mode::DBPSK, "Receiver skips the DBPSK reference and stop symbols");
+    test_differential_receiver(SimpleModem::Mode::DQPSK, "Receiver skips the DQPSK reference and stop symbols");
+    return failures;
+}
@@ -0,0 +1,802 @@
+#pragma once
+
+#include <span>
+#include <ranges>
+#include <vector>
+#include <deque>
+#include <array>
+#include <optional>
+#include <chrono>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "utils.hpp"
+#include "CRC.hpp"
+#include "framing.hpp"
+
+using namespace utils;
+
+// layers 2 to 7 of the stack, shared by main and the benchmark
+
+// OSI model layer 2: Data link layer
+// the layer to convert bit stream to frame of bytes
+enum class Framing {
+    ByteStuffing,   // delimiter and escape character, a frame may grow up to twice its size
+    COBS,           // consistent overhead byte stuffing, at most one extra byte per 254, 0x00 ends a frame
+};
+
+template<Framing framing = Framing::ByteStuffing>
+struct DataLinkFrameHandler {
+    using LowerData = BitsContainer;
+    using UpperData = std::vector<PacketBuffer>;
+
+    CRC8<0x7> crc_checker = {};
+    static constexpr uint8_t frame_delimiter = 0b11010101; // the start or end of a frame
+    static constexpr uint8_t escape_character = 0b01011100; // the escape character (use the ascii code of r'\' here)
+                                                            // when the frame_delimiter or escape_character appears in the frame,
+                                                            // the escape_character will be added before it to avoid ambiguity
+    static constexpr uint8_t cobs_delimiter = 0x00;
+
+    /* ByteStuffing: | frame_delimiter | data frame | crc | frame_delimiter |
+     *               | 1 B             | ...        | 1 B | 1 B             |
+     * COBS:         | COBS(data frame, crc) | cobs_delimiter |
+     *               | ...                   | 1 B            |
+    */
+    PacketBuffer frameBuffer; // the received frame from lower layer, not complete yet
+    bool escape = false; // whether the next byte is escaped
+
+    // frames thrown away, counted by the thread running passUpper and readable from any
+    struct Counters {
+        std::atomic<uint64_t> cobs_errors = 0;  // not valid COBS
+        std::atomic<uint64_t> crc_errors = 0;   // the crc does not match
+    } counters;
+
+    void endOfFrame(UpperData &output) {
+        if (frameBuffer.size() == 0)
+            // the start of a frame, or an idle delimiter
+            return;
+
+        PacketBuffer frame;
+        if constexpr (framing == Framing::COBS) {
+            frame = PacketBuffer(0, 0, frameBuffer.size());
+            if (!cobs_decode(frameBuffer, frame)) {
+                counters.cobs_errors.fetch_add(1, std::memory_order_relaxed);
+                frameBuffer.clear(0);
+                return;
+            }
+        } else
+            frame = std::move(frameBuffer);
+        frameBuffer.clear(0);
+
+        if (crc_checker.check(frame)) {
+            // frame complete!
+            // pass the frame without the crc to upper layer, the storage moves along
+            frame.trim_back(1);
+            output.push_back(std::move(frame));
+        } else {
+            // ignore the frame
+            counters.crc_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // the input is some bits in a frame, maybe not a complete frame
+    UpperData passUpper(LowerData &&input) {
+        if (input.size() % CHAR_BIT != 0)
+            // The physical layer should guarantee that the bit stream is aligned to byte
+            throw std::runtime_error("DataLinkLayerHandler::passUpper: input size must be a multiple of CHAR_BIT");
+
+        UpperData output;
+
+        auto bytes = std::as_const(input).as_span<uint8_t>();
+        auto p = bytes.data(), e = p + bytes.size();
+        while (p != e) {
+            if (escape) {
+                // normal byte
+                frameBuffer.push_back(*p++);
+                escape = false;
+                continue;
+            }
+            // copy the run of normal bytes up to the next special one at once
+            auto q = framing == Framing::COBS
+                ? find_either(p, e, cobs_delimiter, cobs_delimiter)
+                : find_either(p, e, frame_delimiter, escape_character);
+            frameBuffer.append({ p, size_t(q - p) });
+            if (q == e)
+                break;
+            if (framing == Framing::ByteStuffing && *q == escape_character)
+                escape = true;
+            else
+                endOfFrame(output);
+            p = q + 1;
+        }
+
+        return output;
+    }
+
+    LowerData passLower(std::vector<PacketBuffer> &&input) {
+
+        ByteContainer bytes;
+
+        for (auto &&frame : input) {
+            // the crc is stuffed along with the data
+            frame.push_back(crc_checker.get(frame));
+            if constexpr (framing == Framing::COBS) {
+                cobs_encode(frame, bytes);
+                bytes.push_back(cobs_delimiter);
+            } else {
+                bytes.push_back(frame_delimiter);
+                auto p = std::as_const(frame).begin(), e = std::as_const(frame).end();
+                for (;;) {
+                    auto q = find_either(p, e, frame_delimiter, escape_character);
+                    bytes.insert(bytes.end(), p, q);
+                    if (q == e)
+                        break;
+                    bytes.push_back(escape_character);
+                    bytes.push_back(*q);
+                    p = q + 1;
+                }
+                bytes.push_back(frame_delimiter);
+            }
+        }
+
+        LowerData output(bytes.size() * CHAR_BIT);
+        std::ranges::copy(bytes, output.as_span<uint8_t>().begin());
+        return output;
+
+    }
+};
+
+
+
+template<class H, class T>
+struct Packet {
+    H header;
+    T data;
+};
+
+
+
+using MACAddr = uint8_t; // the type of MAC address
+using IPAddr = uint8_t; // the type of IP address
+
+constexpr MACAddr my_mac = 0x01;
+constexpr IPAddr my_ip = 0x01;
+
+// the network layer header, the MAC layer reads the destination to resolve it
+struct IPHeader {
+    IPAddr source_ip;
+    IPAddr destination_ip;
+};
+
+
+struct MACLayerHandler {
+
+    using LowerData = std::vector<PacketBuffer>;
+    using UpperData = std::vector<PacketBuffer>;
+
+    using Clock = std::chrono::steady_clock;
+    
+    /* | Destination MAC | Source MAC | Type | Data |
+     * | 1 B             | 1 B        | 1 B  | ...  |
+    */
+    struct Header {
+        MACAddr destination;
+        MACAddr source;
+        enum class Type : uint8_t {
+            ARP = 0x01,
+            IP = 0x02,
+        } type;
+    };
+
+    
+    struct ARP {
+        enum class Operation : uint8_t {
+            Request = 0x01,
+            Reply = 0x02
+        } operation;
+        IPAddr sender_ip;
+        IPAddr target_ip;   // equal to sender_ip in a gratuitous ARP
+    };
+
+    struct ARPConfig {
+        Clock::duration ttl = std::chrono::seconds(60);                     // a resolved entry is trusted this long
+        Clock::duration request_interval = std::chrono::milliseconds(500);  // at most one request per address in this time
+        int max_requests = 5;       // unanswered requests before the pending packets are dropped
+        size_t max_pending = 32;    // packets held per address while it is resolved
+    } arp_config;
+
+    // IP addresses are one byte, so the cache is a flat table indexed by the address
+    struct ARPEntry {
+        MACAddr mac = 0;
+        bool resolved = false;
+        Clock::time_point expires;
+        Clock::time_point last_request;
+        int requests = 0;                   // sent since the last reply
+        std::vector<PacketBuffer> pending;  // IP packets waiting for the reply
+    };
+    std::array<ARPEntry, 1 << (sizeof(IPAddr) * CHAR_BIT)> arp_cache;
+    bool announced = false;     // whether the gratuitous ARP went out
+
+    static constexpr MACAddr broadcast_address = 0xff;
+
+    LowerData frameBuffer; // the data to be sent to lower layer, not complete yet
+
+    void sendARP(MACAddr destination, ARP::Operation operation, IPAddr target_ip) {
+        frameBuffer.emplace_back();
+        frameBuffer.back().push( Packet {
+            .header = Header {
+                .destination = destination,
+                .source = my_mac,
+                .type = Header::Type::ARP
+            },
+            .data = ARP {
+                .operation = operation,
+                .sender_ip = my_ip,
+                .target_ip = target_ip
+            }
+        });
+    }
+
+    void sendIP(PacketBuffer &&packet, MACAddr destination) {
+        packet.push_header(Header {
+            .destination = destination,
+            .source = my_mac,
+            .type = Header::Type::IP
+        });
+        frameBuffer.emplace_back(std::move(packet));
+    }
+
+    // a fresh mapping, release the packets waiting for it
+    void learn(IPAddr ip, MACAddr mac) {
+        auto &entry = arp_cache[ip];
+        entry.mac = mac;
+        entry.resolved = true;
+        entry.expires = Clock::now() + arp_config.ttl;
+        entry.requests = 0;
+        for (auto &packet : entry.pending)
+            sendIP(std::move(packet), mac);
+        entry.pending.clear();
+    }
+
+    void resolve(PacketBuffer &&packet, IPAddr ip, Clock::time_point now) {
+        auto &entry = arp_cache[ip];
+        if (entry.resolved && now < entry.expires) {
+            sendIP(std::move(packet), entry.mac);
+            return;
+        }
+        // expired entries are resolved again
+        entry.resolved = false;
+        if (entry.pending.size() < arp_config.max_pending)
+            entry.pending.push_back(std::move(packet));
+        else
+            std::cerr << "MACLayerHandler::passLower: too many packets waiting for ARP" << std::endl;
+        requestIfDue(ip, now);
+    }
+
+    void requestIfDue(IPAddr ip, Clock::time_point now) {
+        auto &entry = arp_cache[ip];
+        if (entry.resolved || entry.pending.empty() || now - entry.last_request < arp_config.request_interval)
+            return;
+        if (entry.requests == arp_config.max_requests) {
+            std::cerr << "MACLayerHandler::passLower: no ARP reply, dropping packets" << std::endl;
+            entry.pending.clear();
+            entry.requests = 0;
+            return;
+        }
+        sendARP(broadcast_address, ARP::Operation::Request, ip);
+        entry.last_request = now;
+        entry.requests++;
+    }
+
+    UpperData passUpper(LowerData &&input) {
+
+        UpperData output;
+
+        for (auto& frame: input) {
+
+            auto header = frame.pull_header<Header>();
+            if (!header) {
+                // the frame is too short
+                std::cerr << "MACLayerHandler::passUpper: the frame is too short" << std::endl;
+                continue;
+            }
+            if (header->destination != broadcast_address && header->destination != my_mac) {
+                // the frame is not for me
+                std::cout << "MACLayerHandler::passUpper: the frame is not for me (MAC)" << std::endl;
+                continue;
+            }
+
+            switch (header->type) {
+                case Header::Type::ARP:
+                    {
+                        auto data = frame.pull_header<ARP>();
+                        if (!data) {
+                            std::cerr << "MACLayerHandler::passUpper: the ARP packet is too short" << std::endl;
+                            continue;
+                        }
+                        if (data->sender_ip == my_ip) {
+                            if (header->source != my_mac)
+                                std::cerr << "MACLayerHandler::passUpper: IP address conflict" << std::endl;
+                            continue;
+                        }
+                        switch (data->operation) {
+                            case ARP::Operation::Request:
+                                {
+                                    if (data->target_ip == my_ip) {
+                                        // reply, and remember the asker since it is about to talk to me
+                                        std::cout << "ARP request" << std::endl;
+                                        learn(data->sender_ip, header->source);
+                                        sendARP(header->source, ARP::Operation::Reply, data->sender_ip);
+                                    } else if (data->target_ip == data->sender_ip || arp_cache[data->sender_ip].resolved) {
+                                        // gratuitous ARP, or a known host that may have changed its MAC
+                                        learn(data->sender_ip, header->source);
+                                    }
+                                }
+                                break;
+                            case ARP::Operation::Reply:
+                                {
+                                    if (data->target_ip == my_ip) {
+                                        // update the arp cache
+                                        learn(data->sender_ip, header->source);
+                                        std::cout << "ARP reply" << std::endl;
+                                    }
+                                }
+                                break;
+                            default:
+                                // unknown operation
+                                std::cerr << "MACLayerHandler::passUpper: unknown operation" << std::endl;
+                                continue;
+                        }
+
+                    }
+                    break;
+                case Header::Type::IP: 
+                    // the header is stripped already, pass the payload on without copying
+                    output.push_back(std::move(frame));
+                    break;
+                default:
+                    // unknown type
+                    std::cerr << "MACLayerHandler::passUpper: unknown type" << std::endl;
+                    break;
+            }
+        }
+        return output;
+    }
+
+    std::vector<PacketBuffer> passLower(std::vector<PacketBuffer> &&input) {
+
+        auto now = Clock::now();
+
+        if (!announced) {
+            // gratuitous ARP, neighbours refresh stale entries for my address
+            sendARP(broadcast_address, ARP::Operation::Request, my_ip);
+            announced = true;
+        }
+
+        for (auto&& frame: input) 
+            if (frame.size() > 0) {
+                // send the IP packet
+                auto ip = frame.peek_header<IPHeader>();
+                if (!ip) {
+                    std::cerr << "MACLayerHandler::passLower: the packet has no IP header" << std::endl;
+                    continue;
+                }
+                if (ip->destination_ip == my_ip)
+                    sendIP(std::move(frame), my_mac);
+                else
+                    resolve(std::move(frame), ip->destination_ip, now);
+            }
+
+        // retry the requests without a reply
+        for (int ip = 0; ip < arp_cache.size(); ip++)
+            if (!arp_cache[ip].pending.empty())
+                requestIfDue(ip, now);
+
+        return std::move(frameBuffer);
+    }
+
+};
+
+// OSI model layer 3: Network layer
+// the layer to convert frame of bytes to packet of bytes
+// every packet goes to destination, the MAC layer resolves it by ARP unless it
+// is my own address, which loops back
+template<IPAddr destination = my_ip>
+struct NetworkLayerHandler {
+    using LowerData = std::vector<PacketBuffer>;
+
+    using Header = IPHeader;
+    
+    using UpperData = std::vector<PacketBuffer>;
+
+    UpperData passUpper(LowerData &&input)  {
+
+        UpperData output;
+
+        for (auto&& frame: input) {
+            auto ip = frame.pull_header<Header>();
+            if (!ip) {
+                // the packet is too short
+                std::cerr << "NetworkLayerHandler::passUpper: the packet is too short" << std::endl;
+                continue;
+            }
+            if (ip->destination_ip != my_ip) {
+                // the packet is not for me
+                std::cout << "NetworkLayerHandler::passUpper: the packet is not for me (IP)" << std::endl;
+                continue;
+            }
+
+            output.push_back(std::move(frame));
+        }
+        return output;
+    }
+
+    std::vector<PacketBuffer> passLower(std::vector<PacketBuffer> &&input) {
+        // calculate the output of this layer based on the ouput of upper layer
+        // upper_output -> ouput
+        for (auto &packet: input) {
+            if (packet.size() > 0) {
+                packet.push_header(Header {
+                    .source_ip = my_ip,
+                    .destination_ip = destination,
+                });
+            }
+        }
+        return std::move(input);
+    }
+};
+
+
+// OSI model layer 4: Transport layer
+// the layer to deliver a byte stream reliably and in order, by selective repeat
+struct TransportLayerHandler {
+
+    using LowerData = std::vector<PacketBuffer>;
+    using UpperData = ByteContainer;
+
+    using Clock = std::chrono::steady_clock;
+    using Duration = std::chrono::microseconds;
+
+
+    enum class Protocol : uint8_t {
+        SlidingWindow = 0x01,
+        TCP = 0x02,
+        UDP = 0x03
+    };
+
+    /* | Protocol | SlidingWindowHeader | data |
+     * | 1 B      | 4 B                 | ...  |
+     */
+    struct SlidingWindowHeader {
+        uint16_t is_ack: 1;
+        uint16_t seq_num: 15;       // the segment sent, or the segment acknowledged
+        uint16_t next_expected;     // acks only, the receiver holds every segment before it
+    };
+
+    struct TCPHeader {
+        uint8_t src_port;
+        uint8_t dest_port;
+        uint8_t seq_num;
+        uint8_t ack_num;
+        /// TODO: add more fields
+    };
+
+    struct UDPHeader {
+        uint8_t src_port;
+        uint8_t dest_port;
+        uint8_t length;   // the length including the header
+
+    };
+
+    struct Config {
+        // segments in flight, it should cover the bandwidth-delay product of the link:
+        // a few kbit/s over the sound card buffers (a round trip of several 100 ms)
+        // is a few kB, so 32 segments of 64 B with some margin
+        int window_size = 32;
+        size_t segment_size = 64;           // payload bytes per segment
+        Duration initial_rto = std::chrono::milliseconds(200);
+        Duration min_rto = std::chrono::milliseconds(50);
+        Duration max_rto = std::chrono::seconds(4);
+        int fast_retransmit_threshold = 3;  // acks of later segments before a hole is resent
+    } config;
+
+    // sequence numbers are counted in 64 bit and sent modulo 2^15, selective repeat
+    // needs the window to be at most half of the sequence space
+    static constexpr int64_t seq_modulus = 1 << 15;
+    static constexpr int max_window_size = seq_modulus / 2;
+
+    static uint16_t wrap(int64_t seq) { return uint16_t(seq % seq_modulus); }
+
+    // the full sequence number closest to reference that is sent as seq
+    static int64_t unwrap(uint16_t seq, int64_t reference) {
+        auto d = (seq - reference) % seq_modulus;
+        if (d < 0)
+            d += seq_modulus;
+        if (d >= seq_modulus / 2)
+            d -= seq_modulus;
+        return reference + d;
+    }
+
+    int window() const { return std::clamp(config.window_size, 1, max_window_size); }
+
+
+    // sender
+    struct Segment {
+        PacketBuffer packet;            // headers included, kept for retransmission
+        Clock::time_point sent;
+        int transmissions = 0;
+        int later_acks = 0;             // acks for later segments since the last transmission
+        bool acked = false;
+    };
+
+    std::deque<PacketBuffer> backlog;   // payloads waiting for room in the window
+    std::deque<Segment> inFlight;       // segments [send_base, next_seq)
+    int64_t send_base = 0;
+    int64_t next_seq = 0;
+    std::vector<int64_t> fastRetransmits;
+
+    // Jacobson/Karels estimation with Karn's rule, only segments sent once are sampled
+    bool has_rtt = false;
+    Duration srtt {}, rttvar {}, rto = config.initial_rto;
+
+    void sample_rtt(Duration r) {
+        if (!has_rtt) {
+            srtt = r;
+            rttvar = r / 2;
+            has_rtt = true;
+        } else {
+            rttvar = (3 * rttvar + (srtt > r ? srtt - r : r - srtt)) / 4;
+            srtt = (7 * srtt + r) / 8;
+        }
+        rto = std::clamp(srtt + std::max(Duration(1000), 4 * rttvar), config.min_rto, config.max_rto);
+    }
+
+
+    // receiver
+    std::vector<std::optional<PacketBuffer>> reorderBuffer;  // indexed by seq % window
+    int64_t receive_base = 0;
+    std::vector<PacketBuffer> ackToSend;
+
+    void sendAck(int64_t seq_num) {
+        ackToSend.push_back(PacketBuffer::with_headroom(PacketBuffer::default_headroom));
+        ackToSend.back().push_header(SlidingWindowHeader {
+            .is_ack = true,
+            .seq_num = wrap(seq_num),
+            .next_expected = wrap(receive_base),
+        });
+        ackToSend.back().push_header(Protocol::SlidingWindow);
+    }
+
+    void receiveData(int64_t seq, PacketBuffer &&payload, UpperData &output) {
+        if (reorderBuffer.size() != window())
+            reorderBuffer.resize(window());
+        if (seq >= receive_base + window())
+            // beyond the window, the sender will resend it
+            return;
+        if (seq >= receive_base) {
+            auto &slot = reorderBuffer[seq % window()];
+            if (!slot)
+                slot = std::move(payload);
+            // deliver what is in order now
+            while (auto &next = reorderBuffer[receive_base % window()]) {
+                output.insert(output.end(), std::as_const(*next).begin(), std::as_const(*next).end());
+                next.reset();
+                receive_base++;
+            }
+        }
+        // old segments are acked again, the first ack was lost
+        sendAck(seq);
+    }
+
+    void receiveAck(const SlidingWindowHeader &header) {
+        auto now = Clock::now();
+        auto seq = unwrap(header.seq_num, send_base);
+        auto cumulative = std::min(unwrap(header.next_expected, send_base), next_seq);
+
+        auto acknowledge = [&](Segment &segment) {
+            if (segment.acked)
+                return;
+            segment.acked = true;
+            if (segment.transmissions == 1)
+                sample_rtt(std::chrono::duration_cast<Duration>(now - segment.sent));
+        };
+
+        for (auto s = send_base; s < cumulative; s++)
+            acknowledge(inFlight[s - send_base]);
+        if (seq >= send_base && seq < next_seq) {
+            acknowledge(inFlight[seq - send_base]);
+            // holes before an acked segment count towards fast retransmit
+            for (auto s = std::max(send_base, cumulative); s < seq; s++) {
+                auto &segment = inFlight[s - send_base];
+                if (!segment.acked && ++segment.later_acks == config.fast_retransmit_threshold)
+                    fastRetransmits.push_back(s);
+            }
+        }
+
+        while (!inFlight.empty() && inFlight.front().acked) {
+            inFlight.pop_front();
+            send_base++;
+        }
+    }
+
+    void transmit(Segment &segment, Clock::time_point now, std::vector<PacketBuffer> &output) {
+        segment.sent = now;
+        segment.transmissions++;
+        segment.later_acks = 0;
+        // the copy shares the storage, lower layers copy it when adding their headers
+        output.push_back(segment.packet);
+    }
+
+    UpperData passUpper(LowerData &&input)  {
+        // input from lower
+
+        UpperData output;
+
+        for (auto &&packet: input) {
+            auto protocol = packet.pull_header<Protocol>();
+            if (!protocol) 
+                continue;
+            switch (*protocol) {
+                case Protocol::SlidingWindow:
+                    {
+                        auto header = packet.pull_header<SlidingWindowHeader>();
+                        if (!header)
+                            continue;
+                        if (header->is_ack)
+                            // sender receive ack
+                            receiveAck(*header);
+                        else
+                            // receiver receive data
+                            receiveData(unwrap(header->seq_num, receive_base), std::move(packet), output);
+                    }
+                    break;
+                case Protocol::TCP:
+                    std::cerr << "TransportLayerHandler::passUpper: TCP is not supported" << std::endl;
+                    continue;
+                case Protocol::UDP:
+                    {
+                        auto header = packet.pull_header<UDPHeader>();
+                        if (!header)
+                            continue;
+
+                        output.insert(output.end(), std::as_const(packet).begin(), std::as_const(packet).end());
+                    }
+                    break;
+                default:
+                    std::cerr << "TransportLayerHandler::passUpper: unknown type" << std::endl;
+                    continue;
+            }
+        }
+        return output;
+    }
+
+    
+
+    std::vector<PacketBuffer> passLower(ByteContainer &&input) {
+        // split the input into segments
+        // the payload is copied once here, lower layers prepend into the headroom
+        for (size_t i = 0; i < input.size(); i += config.segment_size) {
+            auto n = std::min(config.segment_size, input.size() - i);
+            backlog.emplace_back(std::span(input).subspan(i, n));
+        }
+
+        // send the acks
+        std::vector<PacketBuffer> output = std::move(ackToSend);
+        ackToSend.clear();
+
+        auto now = Clock::now();
+
+        // holes reported by later acks
+        for (auto seq : fastRetransmits)
+            if (seq >= send_base && seq < next_seq && !inFlight[seq - send_base].acked)
+                transmit(inFlight[seq - send_base], now, output);
+        fastRetransmits.clear();
+
+        // every segment has its own timer, the timeout backs off until a new sample arrives
+        bool timeout = false;
+        for (auto &segment : inFlight)
+            if (!segment.acked && now - segment.sent > rto) {
+                transmit(segment, now, output);
+                timeout = true;
+            }
+        if (timeout)
+            rto = std::min(rto * 2, config.max_rto);
+
+        // new segments while the window has room
+        while (!backlog.empty() && next_seq - send_base < window()) {
+            auto &segment = inFlight.emplace_back(Segment { .packet = std::move(backlog.front()) });
+            backlog.pop_front();
+            segment.packet.push_header(SlidingWindowHeader {
+                .is_ack = false,
+                .seq_num = wrap(next_seq++),
+                .next_expected = 0,
+            });
+            segment.packet.push_header(Protocol::SlidingWindow);
+            transmit(segment, now, output);
+        }
+
+        return output;
+    }
+};
+
+
+// OSI model layer 5: Session layer
+// the layer
+struct SessionLayerHandler {
+
+    auto passUpper(auto &&input)  {
+        // calculate the output of this layer based on the ouput of lower layer
+        // lower_output -> ouput
+        return std::move(input);
+    }
+
+    auto passLower(auto &&input) {
+        // calculate the output of this layer based on the ouput of upper layer
+        // upper_output -> ouput
+        return std::move(input);
+    }
+};
+
+
+// OSI model layer 6: Presentation layer
+// the layer
+struct PresentationLayerHandler {
+
+    auto passUpper(auto &&input)  {
+        // calculate the output of this layer based on the ouput of lower layer
+        // lower_output -> ouput
+        return std::move(input);
+    }
+
+    auto passLower(auto &&input) {
+        // calculate the output of this layer based on the ouput of upper layer
+        // upper_output -> ouput
+        return std::move(input);
+    }
+};
+
+
+// OSI model layer 7: Application layer
+// the layer
+struct ApplicationLayerHandler {
+    using LowerData = ByteContainer;
+    using UpperData = void;
+
+    void passUpper(LowerData &&input) {
+        for (auto c : input)
+            std::cout << c;
+    }
+    LowerData passLower() {
+        return {};
+    }
+};
+
+
+struct FileIOLayer {
+    using LowerData = ByteContainer;
+    using UpperData = void;
+
+    std::ifstream fin { "INPUT.bin" , std::ios::binary };
+    std::ofstream fout { "OUTPUT.bin" , std::ios::binary };
+
+    void passUpper(LowerData &&input) {
+        for (auto c : input)
+            std::cout << c;
+        // write to file
+        fout.write((char*)input.data(), input.size());
+    }
+
+    LowerData passLower() {
+        LowerData output;
+        while (fin) {
+            char c;
+            fin >> c;
+            output.push(c);
+        }
+        return output;
+    }
+
+
+};
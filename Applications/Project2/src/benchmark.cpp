@@ -0,0 +1,241 @@
+#include "device.hpp"
+#include "callbacklayer.hpp"
+#include "layers.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <random>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// runs two stacks back to back through an in-memory sample loop, as fast as
+// the CPU allows, and reports per layer time, allocations and goodput
+
+static std::atomic<size_t> allocations = 0;
+
+void *operator new(size_t n) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+// over-aligned types come here, the array forms forward to these two
+void *operator new(size_t n, std::align_val_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    auto a = size_t(align);
+#ifdef _MSC_VER
+    if (auto p = _aligned_malloc(n ? n : 1, a))
+#else
+    if (auto p = std::aligned_alloc(a, (std::max<size_t>(n, 1) + a - 1) / a * a))
+#endif
+        return p;
+    throw std::bad_alloc();
+}
+#ifdef _MSC_VER
+void operator delete(void *p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
+
+
+using Clock = std::chrono::steady_clock;
+
+// wall time spent inside one layer, the benchmark is single threaded
+template<class L>
+struct LowerDataOf { };
+template<class L> requires requires { typename L::LowerData; }
+struct LowerDataOf<L> { using LowerData = typename L::LowerData; };
+
+template<class L>
+struct Timed : LowerDataOf<L> {
+    L layer;
+    Clock::duration up {}, down {};
+
+    auto passUpper(auto &&input) {
+        auto start = Clock::now();
+        if constexpr (std::is_void_v<decltype(layer.passUpper(std::move(input)))>) {
+            layer.passUpper(std::move(input));
+            up += Clock::now() - start;
+        } else {
+            auto output = layer.passUpper(std::move(input));
+            up += Clock::now() - start;
+            return output;
+        }
+    }
+
+    auto passLower(auto &&...args) {
+        auto start = Clock::now();
+        if constexpr (std::is_void_v<decltype(layer.passLower(std::forward<decltype(args)>(args)...))>) {
+            layer.passLower(std::forward<decltype(args)>(args)...);
+            down += Clock::now() - start;
+        } else {
+            auto output = layer.passLower(std::forward<decltype(args)>(args)...);
+            down += Clock::now() - start;
+            return output;
+        }
+    }
+};
+
+
+// stands in for the acoustic physical layer: one sample per bit, +1/-1 for
+// data and 0 for idle, so the loop needs neither a preamble nor calibration
+struct SampleLoopLayer {
+    using LowerData = DataView<float>;
+    using UpperData = BitsContainer;
+
+    std::vector<bool> sending;
+    size_t sent = 0;
+    BitsContainer received;
+
+    UpperData passUpper(LowerData &&input) {
+        for (auto i = 0; i < input.getNumSamples(); i++) {
+            float v = input(0, i);
+            if (v != 0)
+                received.push_back(v < 0);
+        }
+        // whole bytes only, the rest waits for the next block
+        auto n = received.size() / CHAR_BIT * CHAR_BIT;
+        UpperData output(received.begin(), received.begin() + n);
+        received.erase(received.begin(), received.begin() + n);
+        return output;
+    }
+
+    void passLower(UpperData &&input, LowerData &output) {
+        sending.insert(sending.end(), input.begin(), input.end());
+        for (auto i = 0; i < output.getNumSamples(); i++)
+            output(0, i) = sent < sending.size() ? (sending[sent++] ? -1.f : 1.f) : 0.f;
+        // drop the sent bits once they outgrow the pending ones, not on every block
+        if (sent > sending.size() / 2) {
+            sending.erase(sending.begin(), sending.begin() + sent);
+            sent = 0;
+        }
+    }
+};
+
+
+// frames handed to the data link layer, for the allocation count
+struct CountingDataLink : DataLinkFrameHandler<> {
+    size_t frames = 0;
+    auto passLower(std::vector<PacketBuffer> &&input) {
+        frames += input.size();
+        return DataLinkFrameHandler<>::passLower(std::move(input));
+    }
+};
+
+
+struct PayloadLayer {
+    using LowerData = ByteContainer;
+    using UpperData = void;
+
+    ByteContainer toSend;
+    size_t received = 0;
+
+    void passUpper(LowerData &&input) {
+        received += input.size();
+    }
+
+    LowerData passLower() {
+        return std::exchange(toSend, {});
+    }
+};
+
+
+using Stack = OSI::MultiLayerIOHandler<
+    Timed<SampleLoopLayer>,
+    Timed<CountingDataLink>,
+    Timed<MACLayerHandler>,
+    Timed<NetworkLayerHandler<>>,
+    Timed<TransportLayerHandler>,
+    Timed<SessionLayerHandler>,
+    Timed<PresentationLayerHandler>,
+    Timed<PayloadLayer>
+>;
+
+constexpr const char *layerNames[] = {
+    "Physical (loop)", "DataLink", "MAC", "Network", "Transport", "Session", "Presentation", "Application",
+};
+
+// visit the layers from the physical one up
+void for_each_layer(auto &handler, auto &&f) {
+    f(handler.handler);
+    if constexpr (requires { handler.upper; })
+        for_each_layer(handler.upper, f);
+}
+
+template<int I>
+auto &layer(auto &handler) {
+    if constexpr (I == 0)
+        return handler.handler.layer;
+    else
+        return layer<I - 1>(handler.upper);
+}
+
+
+void run(size_t payloadSize, int blockSize) {
+    auto a = std::make_unique<Stack>();
+    auto b = std::make_unique<Stack>();
+
+    std::vector<int> samples(blockSize);
+    int *channels[] = { samples.data() };
+    DataView<float> view(channels, 1, blockSize, 48000);
+
+    ByteContainer payload(payloadSize);
+    std::mt19937 gen(payloadSize);
+    for (auto &c : payload)
+        c = gen();
+    layer<7>(a->handler).toSend = payload;
+
+    auto &received = layer<7>(b->handler).received;
+    auto allocationsBefore = allocations.load();
+    auto start = Clock::now();
+    constexpr auto deadline = std::chrono::seconds(60);
+    while (received < payloadSize && Clock::now() - start < deadline) {
+        a->outputCallback(view);
+        b->inputCallback(DataView<float>(view));
+        b->outputCallback(view);
+        a->inputCallback(DataView<float>(view));
+    }
+    auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    auto allocationCount = allocations.load() - allocationsBefore;
+    auto frames = layer<1>(a->handler).frames + layer<1>(b->handler).frames;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "payload " << payloadSize << " B: "
+              << (received == payloadSize ? "" : "INCOMPLETE ")
+              << elapsed * 1e3 << " ms, goodput " << received / elapsed / 1e6 << " MB/s, "
+              << frames << " frames, " << double(allocationCount) / std::max<size_t>(frames, 1) << " allocations/frame\n";
+
+    // both stacks together
+    std::vector<double> upMs, downMs;
+    for_each_layer(a->handler, [&](auto &l) {
+        upMs.push_back(std::chrono::duration<double, std::milli>(l.up).count());
+        downMs.push_back(std::chrono::duration<double, std::milli>(l.down).count());
+    });
+    int i = 0;
+    for_each_layer(b->handler, [&](auto &l) {
+        upMs[i] += std::chrono::duration<double, std::milli>(l.up).count();
+        downMs[i++] += std::chrono::duration<double, std::milli>(l.down).count();
+    });
+    for (i = 0; i < upMs.size(); i++)
+        std::cout << "    " << std::left << std::setw(16) << layerNames[i] << std::right
+                  << " up " << std::setw(10) << upMs[i] << " ms"
+                  << "  down " << std::setw(10) << downMs[i] << " ms\n";
+}
+
+
+int main(int argc, char **argv) {
+    int blockSize = argc > 1 ? std::atoi(argv[1]) : 4096;
+    for (size_t size = 16; size <= (1 << 20); size *= 4)
+        run(size, blockSize);
+    return 0;
+}
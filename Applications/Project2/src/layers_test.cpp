@@ -0,0 +1,112 @@
+#include "layers.hpp"
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// the network and MAC layers without a device, frames from the peer are built
+// by hand. every test prints PASS or FAIL and the exit code counts the failures
+
+int failures = 0;
+
+void check(bool ok, const char *name) {
+    std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    failures += !ok;
+}
+
+constexpr MACAddr peer_mac = 0x02;
+constexpr IPAddr peer_ip = 0x02;
+
+using MAC = MACLayerHandler;
+
+std::vector<PacketBuffer> packets(std::vector<uint8_t> payload) {
+    std::vector<PacketBuffer> input;
+    input.emplace_back(payload);
+    return input;
+}
+
+bool is_arp(PacketBuffer frame, MACAddr destination, MAC::ARP::Operation operation, IPAddr target_ip) {
+    auto header = frame.pull_header<MAC::Header>();
+    auto arp = frame.pull_header<MAC::ARP>();
+    return header && arp && header->destination == destination && header->source == my_mac
+        && header->type == MAC::Header::Type::ARP && arp->operation == operation
+        && arp->sender_ip == my_ip && arp->target_ip == target_ip;
+}
+
+bool is_ip(PacketBuffer frame, MACAddr destination, IPAddr destination_ip, const std::vector<uint8_t> &payload) {
+    auto header = frame.pull_header<MAC::Header>();
+    auto ip = frame.pull_header<IPHeader>();
+    return header && ip && header->destination == destination && header->type == MAC::Header::Type::IP
+        && ip->source_ip == my_ip && ip->destination_ip == destination_ip
+        && std::vector<uint8_t>(frame.begin(), frame.end()) == payload;
+}
+
+std::vector<PacketBuffer> reply_from_peer() {
+    std::vector<PacketBuffer> input(1);
+    input[0].push(Packet {
+        .header = MAC::Header { .destination = my_mac, .source = peer_mac, .type = MAC::Header::Type::ARP },
+        .data = MAC::ARP { .operation = MAC::ARP::Operation::Reply, .sender_ip = peer_ip, .target_ip = my_ip },
+    });
+    return input;
+}
+
+// a packet for the peer waits for its MAC, the reply releases it on the next pass down
+void test_resolve_pending_reply_flush() {
+    NetworkLayerHandler<peer_ip> network;
+    MAC mac;
+    std::vector<uint8_t> payload = { 1, 2, 3 };
+
+    auto frames = mac.passLower(network.passLower(packets(payload)));
+    check(frames.size() == 2
+          && is_arp(frames[0], MAC::broadcast_address, MAC::ARP::Operation::Request, my_ip)
+          && is_arp(frames[1], MAC::broadcast_address, MAC::ARP::Operation::Request, peer_ip),
+          "announce and request the peer");
+    check(mac.arp_cache[peer_ip].pending.size() == 1, "packet pending");
+
+    frames = mac.passLower({});
+    check(frames.empty(), "no second request within the interval");
+
+    check(mac.passUpper(reply_from_peer()).empty(), "reply not passed up");
+    check(mac.arp_cache[peer_ip].resolved && mac.arp_cache[peer_ip].mac == peer_mac, "peer learned");
+
+    frames = mac.passLower({});
+    check(frames.size() == 1 && is_ip(frames[0], peer_mac, peer_ip, payload), "pending packet flushed");
+
+    frames = mac.passLower(network.passLower(packets(payload)));
+    check(frames.size() == 1 && is_ip(frames[0], peer_mac, peer_ip, payload), "resolved peer sent at once");
+}
+
+// requests stop after max_requests and the waiting packets go with them
+void test_unanswered() {
+    NetworkLayerHandler<peer_ip> network;
+    MAC mac;
+    mac.arp_config.request_interval = std::chrono::milliseconds(1);
+    mac.arp_config.max_requests = 2;
+
+    size_t requests = 0;
+    auto frames = mac.passLower(network.passLower(packets({ 1 })));
+    for (int i = 0; i < 4; i++) {
+        for (auto &frame : frames)
+            requests += is_arp(frame, MAC::broadcast_address, MAC::ARP::Operation::Request, peer_ip);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        frames = mac.passLower({});
+    }
+    check(requests == 2 && mac.arp_cache[peer_ip].pending.empty(), "unanswered requests drop the packet");
+}
+
+// my own address needs no ARP
+void test_loopback() {
+    NetworkLayerHandler<> network;
+    MAC mac;
+    std::vector<uint8_t> payload = { 4, 5 };
+
+    auto frames = mac.passLower(network.passLower(packets(payload)));
+    check(frames.size() == 2 && is_ip(frames[1], my_mac, my_ip, payload), "loopback sent at once");
+}
+
+int main() {
+    test_resolve_pending_reply_flush();
+    test_unanswered();
+    test_loopback();
+    return failures;
+}
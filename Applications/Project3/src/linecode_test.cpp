@@ -0,0 +1,72 @@
+#include "linecode.hpp"
+
+#include <iostream>
+#include <vector>
+
+// line codes back to back, every test prints PASS or FAIL and the exit code
+// counts the failures
+
+using namespace utils;
+
+int failures = 0;
+
+void check(bool ok, const char *name) {
+    std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    failures += !ok;
+}
+
+BitStream encode(LineCode &code, const std::vector<uint8_t> &bytes) {
+    BitStream bits;
+    code.reset_encoder();
+    for (auto byte : bytes)
+        code.encode(byte, bits);
+    return bits;
+}
+
+// bits from flip on are inverted, as after a polarity change of the line
+std::vector<uint8_t> decode(LineCode &code, const BitStream &bits, size_t flip = SIZE_MAX) {
+    std::vector<uint8_t> bytes;
+    code.reset_decoder();
+    for (size_t i = 0; i < bits.size(); i++)
+        if (auto byte = code.decode(bits[i] != (i >= flip)))
+            bytes.push_back(*byte);
+    return bytes;
+}
+
+void test_round_trip() {
+    std::vector<uint8_t> bytes;
+    for (int i = 0; i < 256; i++)
+        bytes.push_back(i * 37);
+    std::pair<LineCoding, const char *> codings[] = {
+        { LineCoding::B8B10, "B8B10 round trip" },
+        { LineCoding::B4B5, "B4B5 round trip" },
+        { LineCoding::Scrambled, "Scrambled round trip" },
+        { LineCoding::Manchester, "Manchester round trip" },
+    };
+    for (auto [coding, name] : codings) {
+        auto code = make_line_code(coding);
+        check(decode(*code, encode(*code, bytes)) == bytes, name);
+    }
+}
+
+// NRZI keeps the data in the transitions, so only the code group a flip lands in breaks.
+// the low nibble 0 is sent as 11110, its first transition flipped gives 01110, a 6
+void test_b4b5_polarity() {
+    B4B5Code code;
+    std::vector<uint8_t> bytes = { 0xa0, 0x5c, 0x30, 0xff, 0x00 };
+    auto bits = encode(code, bytes);
+
+    auto inverted = bytes;
+    inverted[0] = 0xa6;
+    check(decode(code, bits, 0) == inverted, "B4B5 inverted line breaks the first code group only");
+
+    auto flipped = bytes;
+    flipped[2] = 0x36;
+    check(decode(code, bits, 20) == flipped, "B4B5 polarity flip breaks the code group it lands in only");
+}
+
+int main() {
+    test_round_trip();
+    test_b4b5_polarity();
+    return failures;
+}
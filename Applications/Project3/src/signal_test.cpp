@@ -0,0 +1,56 @@
+#include <cmath>
+#include <iostream>
+#include <numbers>
+#include <vector>
+
+#include "asiodevice.h"
+#include "signal.hpp"
+
+// the float and Q15 receive paths of AsyncPhysicalLayer side by side, every test
+// prints PASS or FAIL and the exit code counts the failures
+
+using namespace ASIO;
+
+int failures = 0;
+
+void check(bool ok, const char *name) {
+    std::cout << (ok ? "PASS " : "FAIL ") << name << std::endl;
+    failures += !ok;
+}
+
+// the busy check of one input callback, from the same driver buffer as float and as Q15
+void test_busy_decision() {
+    constexpr int n = 512;
+    std::vector<int> driver(n);
+    std::vector<int16_t> q15(n);
+    int *channel = driver.data();
+    bool same = true;
+
+    for (float amplitude = 1e-4f; amplitude < 1; amplitude *= 1.1f) {
+        for (int i = 0; i < n; i++)
+            driver[i] = int(amplitude * std::sin(2 * std::numbers::pi * i / 48) * 0x7fffffff);
+        DataView<float> view(&channel, 1, n, 48000);
+
+        float energy = 0;
+        for (int i = 0; i < n; i++) {
+            float x = view(0, i);
+            energy += x * x;
+        }
+        auto raw = view.raw();
+        Signals::to_q15(&raw(0, 0), q15.data(), n);
+        auto energyQ15 = Signals::energy_from_q15(q15.data(), n);
+
+        for (float threshold : { 1e-3f, 1e-2f, 0.1f, 1.f, 10.f, 100.f }) {
+            // Q15 rounds each product, a threshold right at the energy may go either way
+            if (std::abs(energy / threshold - 1) < 0.02f)
+                continue;
+            same &= (energy > threshold) == (energyQ15 > threshold);
+        }
+    }
+    check(same, "float and Q15 input give the same busy decision");
+}
+
+int main() {
+    test_busy_decision();
+    return failures;
+}
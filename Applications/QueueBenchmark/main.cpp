@@ -0,0 +1,163 @@
+#include "utils.hpp"
+#include "asyncio.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// n producers against n consumers moving the same number of items through
+// each queue, reports million items per second for n = 1 .. 16
+
+using namespace utils;
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t capacity = 1024;
+constexpr size_t batch = 32;
+
+// start all threads together and time until the last one is done
+double timed(int producers, int consumers, auto &&produce, auto &&consume) {
+    std::atomic<bool> go = false;
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < producers; i++)
+        threads.emplace_back([&, i] { while (!go) std::this_thread::yield(); produce(i); });
+    for (int i = 0; i < consumers; i++)
+        threads.emplace_back([&, i] { while (!go) std::this_thread::yield(); consume(i); });
+    auto start = Clock::now();
+    go = true;
+    threads.clear();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// each side moves items / n, the checksum catches lost or doubled items
+double run_mutex(int n, size_t items) {
+    ThreadSafeQueue<size_t> q;
+    std::atomic<size_t> sum = 0;
+    auto t = timed(n, n, [&](int i) {
+        for (size_t k = i; k < items; k += n)
+            q.push(size_t(k));
+    }, [&](int i) {
+        size_t s = 0;
+        for (size_t k = i; k < items; k += n)
+            s += q.pop();
+        sum += s;
+    });
+    if (sum != items * (items - 1) / 2)
+        std::cerr << "ThreadSafeQueue lost items" << std::endl;
+    return t;
+}
+
+double run_mpmc(int n, size_t items) {
+    MPMCQueue<size_t> q(capacity);
+    std::atomic<size_t> sum = 0;
+    auto t = timed(n, n, [&](int i) {
+        for (size_t k = i; k < items; k += n)
+            while (!q.try_push(size_t(k)))
+                std::this_thread::yield();
+    }, [&](int i) {
+        size_t s = 0;
+        for (size_t k = i; k < items; k += n) {
+            std::optional<size_t> v;
+            while (!(v = q.try_pop()))
+                std::this_thread::yield();
+            s += *v;
+        }
+        sum += s;
+    });
+    if (sum != items * (items - 1) / 2)
+        std::cerr << "MPMCQueue lost items" << std::endl;
+    return t;
+}
+
+double run_mpmc_batch(int n, size_t items) {
+    MPMCQueue<size_t> q(capacity);
+    std::atomic<size_t> sum = 0;
+    auto t = timed(n, n, [&](int i) {
+        std::vector<size_t> buf;
+        for (size_t k = i; k < items; k += n)
+            buf.push_back(k);
+        for (std::span<size_t> rest = buf; !rest.empty(); ) {
+            auto m = q.try_push_batch(rest.first(std::min(batch, rest.size())));
+            if (m == 0)
+                std::this_thread::yield();
+            rest = rest.subspan(m);
+        }
+    }, [&](int i) {
+        size_t s = 0, left = 0, buf[batch];
+        for (size_t k = i; k < items; k += n)
+            left++;
+        while (left > 0) {
+            auto m = q.try_pop_batch(std::span(buf, std::min(batch, left)));
+            if (m == 0)
+                std::this_thread::yield();
+            for (size_t j = 0; j < m; j++)
+                s += buf[j];
+            left -= m;
+        }
+        sum += s;
+    });
+    if (sum != items * (items - 1) / 2)
+        std::cerr << "MPMCQueue batch lost items" << std::endl;
+    return t;
+}
+
+// the consumers are coroutines suspended in async_pop, one Context each
+double run_async(int n, size_t items) {
+    AsyncQueue<size_t> q(capacity);
+    std::atomic<size_t> sum = 0;
+    std::atomic<int> done = 0;
+    std::vector<std::unique_ptr<Context>> contexts;
+    for (int i = 0; i < n; i++)
+        contexts.push_back(std::make_unique<Context>());
+
+    auto start = Clock::now();
+    for (int i = 0; i < n; i++) {
+        boost::asio::co_spawn(*contexts[i], [&, i]() -> awaitable<void> {
+            size_t s = 0;
+            for (size_t k = i; k < items; k += n)
+                s += co_await q.async_pop();
+            sum += s;
+            done++;
+        }, boost::asio::detached);
+    }
+    {
+        std::vector<std::jthread> producers;
+        for (int i = 0; i < n; i++)
+            producers.emplace_back([&, i] {
+                for (size_t k = i; k < items; k += n)
+                    while (!q.try_push(size_t(k)))
+                        std::this_thread::yield();
+            });
+    }
+    while (done < n)
+        std::this_thread::yield();
+    auto t = std::chrono::duration<double>(Clock::now() - start).count();
+    if (sum != items * (items - 1) / 2)
+        std::cerr << "AsyncQueue lost items" << std::endl;
+    return t;
+}
+
+
+int main(int argc, char **argv) {
+    size_t items = argc > 1 ? std::atoll(argv[1]) : 1 << 20;
+
+    std::cout << "Mitems/s, " << items << " items, capacity " << capacity << ", batch " << batch << "\n"
+              << std::setw(8) << "threads"
+              << std::setw(16) << "ThreadSafeQueue"
+              << std::setw(12) << "MPMCQueue"
+              << std::setw(12) << "batched"
+              << std::setw(12) << "async_pop" << "\n";
+    for (int n = 1; n <= 16; n *= 2) {
+        auto rate = [&](double seconds) { return items / seconds / 1e6; };
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(8) << n
+                  << std::setw(16) << rate(run_mutex(n, items))
+                  << std::setw(12) << rate(run_mpmc(n, items))
+                  << std::setw(12) << rate(run_mpmc_batch(n, items))
+                  << std::setw(12) << rate(run_async(n, items)) << std::endl;
+    }
+    return 0;
+}
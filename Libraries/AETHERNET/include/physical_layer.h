@@ -1,6 +1,10 @@
 #pragma once
 
+#include <array>
+
 #include "utils.hpp"
+#include "signal.hpp"
+#include "linecode.hpp"
 #include "asyncio.hpp"
 #include "asiodevice.h"
 
@@ -30,30 +34,97 @@ namespace OSI {
 
         const float amplitude;  // amplitude of the sending signal
         const float threshold;  // threshold for preamble detection
+        const float detectionFactor;    // CFAR factor, 0 for the fixed threshold
+        const bool fixedPoint;          // receive path in Q15 integers instead of float
         const int payload;      // bytes per CRC check
+        const std::unique_ptr<LineCode> lineCode;
         const int packetBits;   // bits per packet (calculated by payload)
         const int carrierSize;  // size of carrier
         const int interSize;    // size of interval between packets
 
+        const uint8_t address;  // identifies this node to the receivers' drift estimates
+        const int maxRate;      // highest entry of the rate table this node may use
+        const float minSnr;     // SNR (dB) a data bit needs to be trusted
+
         /*
-            | preamble | size | done | data | crc |
+            | preamble | size | source | done | rate | feedback | check | data | crc |
+
+            everything after the preamble goes through lineCode
+
+            the header and its check byte always go at carrierSize samples per bit,
+            the rest of the frame at carrierSize >> rate. feedback is the rate this
+            node would like to receive at, measured from the frames of its peers.
+            check is a CRC of the header alone, the rate is needed before the crc of
+            the frame arrives; feedback and the peer are only trusted once both pass
         */
         struct Header {
-            unsigned size: 31;
+            unsigned size: 19;
+            unsigned source: 8;
             unsigned done: 1;
+            unsigned rate: 2;
+            unsigned feedback: 2;
         };
         static_assert(sizeof(Header) == 4);
 
+        /** @brief what the receiver learned about a sender */
+        struct Peer {
+            double drift = 0;       // sample clock offset (ppm)
+            float snr = 0;          // per sample SNR (dB) of its recent frames
+            int frames = 0;
+            uint8_t rate = 0;       // rate it should send at
+            uint8_t feedback = 0;   // rate it asked this node to send at
+        };
+
         std::vector<float> preamble, carrier;
+        float preambleNorm;                 // L2 norm of the preamble, for the normalized correlation
+        std::vector<int16_t> preambleQ15;   // preamble / preambleScale for the fixed point correlation
+        float preambleScale;
+
+        Signals::NoiseFloor energyFloor;        // mean energy of the input callbacks
+        Signals::NoiseFloor correlationFloor;   // normalized correlation with the preamble
+
+        Signals::TimingRecovery timing;     // bit grid of the frame being received
+        std::unordered_map<uint8_t, Peer> peers;
+        // Peer::feedback by address and its slowest over the known peers, for the sender thread
+        std::array<std::atomic<uint8_t>, 256> txRates {};
+        std::atomic<uint8_t> broadcastRate = 0;
+        std::atomic<uint8_t> feedbackRate = 0;  // the slowest rate any peer should use
+
+        void update_rate(Peer &peer, std::optional<float> snr);
+
+        /** @brief the rate destination asked for, or the slowest any known peer asked for */
+        int tx_rate(std::optional<uint8_t> destination) const;
 
-        PacketStreamBuffer sSignalBuffer;
+        PacketRing<float> sSignalBuffer;    // frames waiting for the output callback, one packet per send
         ByteStreamBuffer rSignalBuffer, sDataBuffer;
-        ThreadSafeQueue<ByteContainer> rPacketQueue;
+        AsyncQueue<ByteContainer> rPacketQueue;
 
         Context senderContext, receiverContext;
 
 
-        void send_raw(BitsContainer &&rawBits);
+        /**
+         * @brief modulate the frames in rawBits into sSignalBuffer, one packet per frame
+         *
+         * @return message_size if a frame can never fit in sSignalBuffer
+         */
+        awaitable<std::error_code> send_raw(BitStream rawBits, int rate);
+
+        /** @brief line code a frame header followed by its check byte */
+        void encode_header(const Header &header, BitStream &rawBits);
+
+        /** @brief cut the whole bytes of data into line coded frames of header, data and crc */
+        BitStream encode_frames(const BitStream &data, int rate);
+
+        /**
+         * @brief run the receiver state machine over rSignalBuffer
+         *
+         * @tparam S float, or int16_t Q15 samples for the fixed point path
+         */
+        template<typename S>
+        void receive();
+
+        static float sample(float x) { return x; }
+        static float sample(int16_t x) { return x * (1.f / 32768); }
 
         /**
          * @brief async wait for rData to arrive
@@ -72,6 +143,17 @@ namespace OSI {
             int carrierSize;
             int interSize;
             std::string preambleFile;
+            float timingGain = 0.1;     // loop gain of the symbol timing recovery, 0 to disable
+            float driftGain = 0.001;    // loop gain of the clock drift tracking, 0 to disable
+            float detectionFactor = 0;  // detect busy channel and preambles this many deviations above
+                                        // the tracked noise floor instead of with threshold, 0 to disable
+            bool fixedPoint = false;    // take the driver samples as Q15 integers, skipping the float conversion
+            LineCoding lineCoding = LineCoding::B8B10;
+            uint8_t address = 0;        // sent as Header::source
+            int maxRate = 0;            // data at carrierSize >> rate samples per bit, up to 3, 0 to disable
+            float minSnr = 16;          // per bit SNR (dB) required before stepping up a rate
+            size_t sendBufferSamples = 1 << 22; // transmit ring, a frame must fit in it
+            size_t sendBufferPackets = 64;      // frames that can wait for the output callback
         };
 
         AsyncPhysicalLayer(Config c);
@@ -80,16 +162,19 @@ namespace OSI {
          * @brief send bits in the BitContainer
          *
          * @param data
+         * @param destination address of the receiver, whose feedback picks the rate;
+         *        without one the frames go at the slowest rate any known peer asked for
          */
-        awaitable<void> async_send(BitsContainer &&data);
+        awaitable<void> async_send(BitsContainer &&data, std::optional<uint8_t> destination = {});
 
 
         /**
          * @brief send bits from the send buffer.
          *
          * @param sendbuf
+         * @param destination as for the BitsContainer overload
          */
-        awaitable<void> async_send(ByteStreamBuffer &sendbuf);
+        awaitable<void> async_send(ByteStreamBuffer &sendbuf, std::optional<uint8_t> destination = {});
 
 
         /**
@@ -1,5 +1,4 @@
 #include "physical_layer.h"
-#include "8b10b.h"
 #include "CRC.hpp"
 
 using namespace utils;
@@ -10,8 +9,8 @@ namespace OSI {
 void AsyncPhysicalLayer::outputCallback(DataView<float> &view) noexcept {
 
     assert(view.getNumChannels() == 2);
-    auto p = std::span(boost::asio::buffer_cast<const float *>(sSignalBuffer.data()), sSignalBuffer.size() / sizeof(float));
-    auto front_packet_size = sSignalBuffer.front_packet_size() / sizeof(float);
+    auto size = sSignalBuffer.size();
+    auto front_packet_size = sSignalBuffer.front_packet_size();
     auto n_samples = view.getNumSamples();
     auto consume_size = 0;
 
@@ -27,8 +26,8 @@ void AsyncPhysicalLayer::outputCallback(DataView<float> &view) noexcept {
             consume_size = 0;
         }
     } else {
-        if (p.size() < n_samples) {
-            consume_size = p.size();
+        if (size < n_samples) {
+            consume_size = size;
             sending = false;
         } else {
             consume_size = n_samples;
@@ -36,9 +35,19 @@ void AsyncPhysicalLayer::outputCallback(DataView<float> &view) noexcept {
         }
     }
 
-    for (auto i = 0; i < n_samples; i++)
-        view(0, i) = view(1, i) = i < consume_size ? p[i] : 0;
-    sSignalBuffer.consume(consume_size * sizeof(float));
+    // the samples may span several packets, each one is contiguous
+    auto i = 0;
+    while (i < consume_size) {
+        auto p = sSignalBuffer.front();
+        auto n = std::min<size_t>(p.size(), consume_size - i);
+        if (n == 0)
+            break;
+        for (auto j = 0; j < n; j++, i++)
+            view(0, i) = view(1, i) = p[j];
+        sSignalBuffer.consume(n);
+    }
+    for (; i < n_samples; i++)
+        view(0, i) = view(1, i) = 0;
 
 }
 
@@ -47,150 +56,245 @@ void AsyncPhysicalLayer::outputCallback(DataView<float> &view) noexcept {
 void AsyncPhysicalLayer::inputCallback(DataView<float> &&view) noexcept {
 
     assert(view.getNumChannels() == 1);
-    auto p = std::span(boost::asio::buffer_cast<float *>(rSignalBuffer.prepare(view.getNumSamples() * sizeof(float))), view.getNumSamples());
     float sum = 0;
-    for (auto i = 0; i < p.size(); i++) {
-        p[i] = view(0, i);
-        sum += p[i] * p[i];
+    if (fixedPoint) {
+        // Q15 straight from the driver buffer, half the bytes of float and no per sample conversion
+        auto raw = view.raw();
+        auto n = raw.getNumSamples();
+        auto p = boost::asio::buffer_cast<int16_t *>(rSignalBuffer.prepare(n * sizeof(int16_t)));
+        Signals::to_q15(&raw(0, 0), p, n);
+        sum = Signals::energy_from_q15(p, n);
+        rSignalBuffer.commit(n * sizeof(int16_t));
+    } else {
+        auto p = std::span(boost::asio::buffer_cast<float *>(rSignalBuffer.prepare(view.getNumSamples() * sizeof(float))), view.getNumSamples());
+        for (auto i = 0; i < p.size(); i++) {
+            p[i] = view(0, i);
+            sum += p[i] * p[i];
+        }
+        rSignalBuffer.commit(view.getNumSamples() * sizeof(float));
     }
-    rSignalBuffer.commit(view.getNumSamples() * sizeof(float));
 
-    busy = sum > threshold;
+    if (detectionFactor > 0)
+        busy = energyFloor.detect(sum / view.getNumSamples(), detectionFactor);
+    else
+        busy = sum > threshold;
 
     // process received signal in the receiver context (in another thread)
     // so that the inputCallback will not be blocked
     boost::asio::post(receiverContext, [&] {
+        if (fixedPoint)
+            receive<int16_t>();
+        else
+            receive<float>();
+    });
+}
 
-        static int fromLastPreamble = 0;
+
+template<typename S>
+void AsyncPhysicalLayer::receive() {
+
+
+    static int fromLastPreamble = 0;
+    #ifdef RECORD
+    static std::ofstream rSignalFile { "rSignal.txt" };
+    #endif
+    static CRC8<0x7> CRCChecker;
+    static enum class ReceiveState : char {
+        preambleDetection,
+        dataExtraction
+    } receiveState = ReceiveState::preambleDetection;
+
+    auto rSignal = std::span(boost::asio::buffer_cast<const S *>(rSignalBuffer.data()), rSignalBuffer.size() / sizeof(S));
+
+    for (auto t = 0; t < rSignal.size(); t++, fromLastPreamble++) {
+        auto x = sample(rSignal[t]);
         #ifdef RECORD
-        static std::ofstream rSignalFile { "rSignal.txt" };
+        rSignalFile << x << '\n';
         #endif
-        static CRC8<0x7> CRCChecker;
-        static enum class ReceiveState : char {
-            preambleDetection,
-            dataExtraction
-        } receiveState = ReceiveState::preambleDetection;
-
-        auto rSignal = std::span(boost::asio::buffer_cast<const float *>(rSignalBuffer.data()), rSignalBuffer.size() / sizeof(float));
-
-        for (auto t = 0; t < rSignal.size(); t++, fromLastPreamble++) {
-            #ifdef RECORD
-            rSignalFile << rSignal[t] << '\n';
-            #endif
-            switch (receiveState) {
-                case ReceiveState::preambleDetection:
-                    {
-                        static std::deque<float> rSignalQueue;
-                        rSignalQueue.push_back(rSignal[t]);
-                        if (rSignalQueue.size() < preamble.size())
+        switch (receiveState) {
+            case ReceiveState::preambleDetection:
+                {
+                    static SlidingWindow<S> window(preamble.size());
+                    static double windowEnergy = 0;
+                    static float peak = 0;          // best correlation of the current detection
+                    if (window.full())
+                        windowEnergy = std::max(windowEnergy - sample(window.front()) * sample(window.front()), 0.);
+                    window.push(rSignal[t]);
+                    windowEnergy += x * x;
+                    if (!window.full())
+                        continue;
+                    float sum;
+                    if constexpr (std::is_same_v<S, int16_t>)
+                        sum = float(Signals::dot_q15(window.data(), preambleQ15.data(), preamble.size())) * preambleScale;
+                    else
+                        sum = Signals::dot(window.data(), preamble.data(), preamble.size());
+                    bool hit;
+                    if (detectionFactor > 0) {
+                        // normalized cross-correlation, independent of the volume
+                        sum /= std::sqrt(std::max(windowEnergy, 1e-12)) * preambleNorm;
+                        hit = correlationFloor.detect(sum, detectionFactor);
+                    } else {
+                        hit = sum > threshold;
+                    }
+                    if (fromLastPreamble <= preamble.size())
+                        continue;
+                    if (hit && sum > peak) {
+                        // keep climbing to the top of the correlation peak
+                        peak = sum;
+                    } else if (peak > 0) {
+                        // the preamble ended on the previous sample, this one is data
+                        peak = 0;
+                        fromLastPreamble = 0;
+                        window.clear();
+                        windowEnergy = 0;
+                        timing.reset();
+                        timing.push(x);
+                        lineCode->reset_decoder();
+                        receiveState = ReceiveState::dataExtraction;
+                    }
+                }
+                break;
+            case ReceiveState::dataExtraction:
+                {
+                    static enum class Receiving : char { len, data, crc } cur = Receiving::len;
+                    static Header header;               // physical layer header
+                    static int headerIndex = 0;         // header bytes received
+                    static ByteContainer rDataDecoded;  // bytes only contains decoded data
+
+                    static bool is_last_packet = false;
+                    static double bitSum, bitSumSq;     // bit integrals after the header, for the SNR
+                    static int bitCount;
+                    if (auto sum = timing.push(x)) {
+                        if (cur != Receiving::len) {
+                            bitSum += std::abs(*sum);
+                            bitSumSq += *sum * *sum;
+                            bitCount++;
+                        }
+
+                        std::optional<uint8_t> decoded;
+                        try {
+                            decoded = lineCode->decode(*sum < 0);
+                        } catch (const std::exception& e) {
+                            // misdetection of preamble
+                            #ifdef DEBUG
+                                std::cerr << "Line decode failed: " << e.what() << std::endl;
+                            #endif
+                            cur = Receiving::len;
+                            headerIndex = 0;
+                            receiveState = ReceiveState::preambleDetection;
                             continue;
-                        float sum = 0;
-                        for (auto tt = 0; tt < preamble.size(); tt++)
-                            sum += rSignalQueue[tt] * preamble[tt];
-                        rSignalQueue.pop_front();
-                        if (sum > threshold && fromLastPreamble > preamble.size()) {
-                            fromLastPreamble = 0;
-                            rSignalQueue.clear();
-                            receiveState = ReceiveState::dataExtraction;
                         }
-                    }
-                    break;
-                case ReceiveState::dataExtraction:
-                    {
-                        static enum class Receiving : char { len, data, crc } cur = Receiving::len;
-                        static Header header;               // physical layer header
-                        static BitsContainer rDataEncoded;  // bits encoded with 8B10B and container length, data and crc.
-                        static ByteContainer rDataDecoded;  // bytes only contains decoded data
-
-                        // get rDataEncoded from rSignal
-                        static auto dt = 0;
-                        static float sum = 0;
-                        static bool is_last_packet = false;
-                        sum += rSignal[t] * carrier[dt];
-                        dt++;
-                        if (dt % carrierSize == 0) {
-                            rDataEncoded.push_back(sum < 0);
-                            sum = 0;
-                            dt = 0;
-
-                            if (rDataEncoded.size() > 0 && rDataEncoded.size() % 10 == 0) {
-                                auto lastrDataIndex = rDataEncoded.size() / 10 - 1;
-                                uint8_t byte;
-                                try {
-                                    auto encoded = rDataEncoded.get<10>(lastrDataIndex);
-                                    auto decoded = B8B10::decode(encoded);
-                                    byte = (uint8_t)decoded.to_ulong();
-                                } catch (const std::exception& e) {
-                                    // misdetection of preamble
-                                    #ifdef DEBUG
-                                        std::cerr << "8B10B decode failed" << std::endl;
-                                    #endif
-                                    cur = Receiving::len;
-                                    rDataEncoded.clear();
-                                    receiveState = ReceiveState::preambleDetection;
-                                    continue;
-                                }
-                                switch (cur) {
-                                    case Receiving::len:
-                                        ((char*)&header)[lastrDataIndex] = byte;
-                                        if (rDataEncoded.size() / 10 == sizeof(Header)) {
-                                            if (header.size > 0) {
-                                                is_last_packet = header.done;
-                                                cur = Receiving::data;
-                                                CRCChecker.reset();
-                                                rDataDecoded.clear();
-                                            } else {
-                                                std::cerr << "Payload Error: " << header.size << std::endl;
-                                                receiveState = ReceiveState::preambleDetection;
-                                            }
-                                        }
-                                        break;
-                                    case Receiving::data:
-                                        rDataEncoded.clear();
-                                        CRCChecker.update(byte);
-                                        rDataDecoded.push_back(byte);
-                                        if (rDataDecoded.size() == header.size)
-                                            cur = Receiving::crc;
+
+                        if (decoded) {
+                            auto byte = *decoded;
+                            switch (cur) {
+                                case Receiving::len:
+                                    if (headerIndex == 0)
+                                        CRCChecker.reset();
+                                    CRCChecker.update(byte);
+                                    if (headerIndex < sizeof(Header)) {
+                                        ((char*)&header)[headerIndex++] = byte;
                                         break;
-                                    case Receiving::crc:
-                                        rDataEncoded.clear();
-                                        CRCChecker.update(byte);
-                                        if (CRCChecker.q == 0) {
-                                            // CRC OK
-                                            static ByteContainer rDataBuffer;
-                                            for (auto i = 0; i < rDataDecoded.size(); i++)
-                                                rDataBuffer.push(rDataDecoded[i]);
-                                            if (is_last_packet)
-                                                rPacketQueue.push(std::move(rDataBuffer));
-                                        } else {
-                                            // CRC FAILED
-                                            #ifdef DEBUG
-                                                std::cerr << "CRC failed" << std::endl;
-                                                std::cout << rDataDecoded << std::endl;
-                                            #endif
-                                        }
-                                        cur = Receiving::len;
-                                        header.size = 0;
+                                    }
+                                    // the check byte behind the header
+                                    headerIndex = 0;
+                                    if (CRCChecker.q == 0 && header.size > 0 && (carrierSize >> header.rate) > 0) {
+                                        is_last_packet = header.done;
+                                        // continue from this sender's known clock offset
+                                        if (auto it = peers.find(header.source); it != peers.end())
+                                            timing.set_ppm(it->second.drift);
+                                        timing.rescale(carrierSize >> header.rate);
+                                        bitSum = bitSumSq = bitCount = 0;
+                                        cur = Receiving::data;
+                                        CRCChecker.reset();
                                         rDataDecoded.clear();
+                                    } else {
+                                        std::cerr << "Header Error: " << header.size << std::endl;
                                         receiveState = ReceiveState::preambleDetection;
-                                        break;
-                                }
+                                    }
+                                    break;
+                                case Receiving::data:
+                                    CRCChecker.update(byte);
+                                    rDataDecoded.push_back(byte);
+                                    if (rDataDecoded.size() == header.size)
+                                        cur = Receiving::crc;
+                                    break;
+                                case Receiving::crc:
+                                    CRCChecker.update(byte);
+                                    if (CRCChecker.q == 0) {
+                                        // CRC OK
+                                        auto &peer = peers[header.source];
+                                        peer.feedback = std::min<int>(header.feedback, maxRate);
+                                        txRates[header.source] = peer.feedback;
+                                        peer.drift = timing.ppm();
+                                        auto mean = bitSum / bitCount;
+                                        auto snr = mean * mean / std::max(bitSumSq / bitCount - mean * mean, 1e-12);
+                                        update_rate(peer, 10 * std::log10(snr / (carrierSize >> header.rate)));
+                                        static ByteContainer rDataBuffer;
+                                        for (auto i = 0; i < rDataDecoded.size(); i++)
+                                            rDataBuffer.push(rDataDecoded[i]);
+                                        if (is_last_packet && !rPacketQueue.try_push(std::move(rDataBuffer))) {
+                                            // nobody reads, drop rather than stall the receiver
+                                            std::cerr << "Packet queue full" << std::endl;
+                                            rDataBuffer.clear();
+                                        }
+                                    } else {
+                                        // CRC FAILED
+                                        #ifdef DEBUG
+                                            std::cerr << "CRC failed" << std::endl;
+                                            std::cout << rDataDecoded << std::endl;
+                                        #endif
+                                        // only a known peer, a damaged frame must not add one
+                                        if (auto it = peers.find(header.source); it != peers.end())
+                                            update_rate(it->second, {});
+                                    }
+                                    cur = Receiving::len;
+                                    header.size = 0;
+                                    rDataDecoded.clear();
+                                    receiveState = ReceiveState::preambleDetection;
+                                    break;
                             }
                         }
                     }
-                    break;
-            }
+                }
+                break;
         }
+    }
 
-        rSignalBuffer.consume(rSignal.size() * sizeof(float));
+    rSignalBuffer.consume(rSignal.size() * sizeof(S));
+}
 
-    });
+
+void AsyncPhysicalLayer::update_rate(Peer &peer, std::optional<float> snr) {
+    if (snr) {
+        peer.snr = peer.frames++ == 0 ? *snr : peer.snr + 0.25f * (*snr - peer.snr);
+        // the fastest rate whose bits still collect enough energy, stepping up one rate per frame
+        auto fit = 0;
+        for (auto r = 1; r <= maxRate; r++)
+            if (peer.snr + 10 * std::log10(float(carrierSize >> r)) >= minSnr)
+                fit = r;
+        peer.rate = std::min<int>(fit, peer.rate + 1);
+    } else if (peer.rate > 0) {
+        // a lost frame steps down at once
+        peer.rate--;
+    }
+    auto slowest = maxRate;
+    auto slowestFeedback = peers.empty() ? 0 : maxRate;
+    for (auto &[source, p] : peers) {
+        slowest = std::min<int>(slowest, p.rate);
+        slowestFeedback = std::min<int>(slowestFeedback, p.feedback);
+    }
+    feedbackRate = slowest;
+    broadcastRate = slowestFeedback;
 }
 
 
-void AsyncPhysicalLayer::send_raw(BitsContainer &&rawBits)  {
+int AsyncPhysicalLayer::tx_rate(std::optional<uint8_t> destination) const {
+    return destination ? txRates[*destination].load() : broadcastRate.load();
+}
+
 
-    assert(rawBits.size() % 10 == 0);
+awaitable<std::error_code> AsyncPhysicalLayer::send_raw(BitStream rawBits, int rate)  {
 
     #ifdef RECORD
     static std::ofstream sSignalFile { "sSignal.txt" };
@@ -198,56 +302,134 @@ void AsyncPhysicalLayer::send_raw(BitsContainer &&rawBits)  {
     #endif
 
     auto nBits = rawBits.size();
-    auto nPacket = nBits / packetBits;
     auto tickPerPacket = preamble.size() + packetBits * carrierSize + interSize * 2;
-    auto nticks = tickPerPacket * nPacket;
 
-    auto p = boost::asio::buffer_cast<float *>(sSignalBuffer.prepare(tickPerPacket * (nPacket + 1) * sizeof(float)));
-    auto t = 0;
+    auto headerBits = int(lineCode->bits(sizeof(Header) + 1));
+    auto dataCarrierSize = carrierSize >> rate;
+
+    // one packet per frame, so only a single frame has to fit in the ring
     for (auto i = 0; i < nBits; i += packetBits) {
+        // sized for the base rate, faster frames use less
+        std::error_code ec;
+        std::span<float> p;
+        while ((p = sSignalBuffer.prepare(tickPerPacket, ec)).empty()) {
+            if (ec)
+                co_return ec;
+            co_await Asyncio::sleep(1ms);   // the output callback frees the ring
+        }
+        auto t = 0;
         for (auto j = 0; j < interSize; j++)
             p[t++] = 0;
         for (auto j = 0; j < preamble.size(); j++)
             p[t++] = preamble[j] * amplitude;
         for (auto j = 0; j < packetBits && i + j < nBits; j++)
-            for (auto k = 0; k < carrierSize; k++)
+            for (auto k = 0; k < (j < headerBits ? carrierSize : dataCarrierSize); k++)
                 p[t++] = carrier[k] * (rawBits[i + j] == 0 ? amplitude : -amplitude);
         for (auto j = 0; j < interSize; j++)
             p[t++] = 0;
+        #ifdef RECORD
+        for (auto j = 0; j < t; j++)
+            sSignalFile << p[j] << '\n';
+        #endif
+        sSignalBuffer.commit(t);
     }
-    #ifdef RECORD
-    for (auto i = 0; i < t; i++)
-        sSignalFile << p[i] << '\n';
-    #endif
-    sSignalBuffer.commit(t * sizeof(float));
-
+    co_return std::error_code {};
 }
 
 awaitable<ByteContainer> AsyncPhysicalLayer::wait_data() {
-    while (rPacketQueue.empty())
-        co_await asyncio.sleep(0s);     // yield the receiverContext
-    co_return rPacketQueue.pop();
+    co_return co_await rPacketQueue.async_pop();
+}
+
+void AsyncPhysicalLayer::encode_header(const Header &header, BitStream &rawBits) {
+    CRC8<7> CRCChecker;
+    CRCChecker.reset();
+    lineCode->reset_encoder();
+    for (int j = 0; j < sizeof(Header); j++) {
+        auto byte = ((const uint8_t *)&header)[j];
+        CRCChecker.update(byte);
+        lineCode->encode(byte, rawBits);
+    }
+    lineCode->encode(CRCChecker.get(), rawBits);
 }
 
+BitStream AsyncPhysicalLayer::encode_frames(const BitStream &data, int rate) {
+    BitStream rawBits;
+    Header header;
+    CRC8<7> CRCChecker;
+    CRCChecker.reset();
+    auto n = int(data.size() / 8);
+
+    for (auto i = 0; i < n; i++) {
+        // calculate real payload at the beginning of the package
+        if (i % payload == 0) {
+            header.size = std::min<int>(n - i, payload);
+            header.source = address;
+            header.rate = rate;
+            header.feedback = feedbackRate;
+            header.done = (n - 1) / payload == i / payload;
+            encode_header(header, rawBits);
+        }
+
+        auto byte = (uint8_t)data.read_bits(i * 8, 8);
+        CRCChecker.update(byte);
+        lineCode->encode(byte, rawBits);
+
+        // add CRC at the end of the package
+        if ((i + 1 + payload - header.size) % payload == 0) {
+            lineCode->encode(CRCChecker.get(), rawBits);
+            CRCChecker.reset();
+        }
+    }
+    return rawBits;
+}
+
+
 AsyncPhysicalLayer::AsyncPhysicalLayer(Config c)
   : amplitude(c.amplitude),
     threshold(c.threshold),
+    detectionFactor(c.detectionFactor),
+    fixedPoint(c.fixedPoint),
     payload(c.payload),
-    packetBits((c.payload + 1 + sizeof(Header)) * 10), // +1 for length
+    lineCode(make_line_code(c.lineCoding)),
+    packetBits(lineCode->bits(c.payload + 2 + sizeof(Header))), // +2 for the header check and crc
     carrierSize(c.carrierSize),
     interSize(c.interSize),
+    address(c.address),
+    maxRate(c.maxRate),
+    minSnr(c.minSnr),
     preamble(from_file<float>(c.preambleFile)),
-    carrier(c.carrierSize, 1.f) 
+    carrier(c.carrierSize, 1.f),
+    preambleNorm(std::sqrt(std::inner_product(preamble.begin(), preamble.end(), preamble.begin(), 0.f))),
+    preambleScale(std::max(1e-12f, std::abs(*std::max_element(preamble.begin(), preamble.end(), [](float a, float b) { return std::abs(a) < std::abs(b); })))),
+    energyFloor(0.05),
+    correlationFloor(0.001),
+    timing(c.carrierSize, c.timingGain, c.driftGain),
+    sSignalBuffer(c.sendBufferSamples, c.sendBufferPackets)
 {
-    if (packetBits % 8 != 0) {
-        auto corrected_payload = packetBits / 40 * 4 - 1 - sizeof(Header);
+    preambleQ15 = Signals::to_q15(preamble, preambleScale);
+    auto tenBitCode = c.lineCoding == LineCoding::B8B10 || c.lineCoding == LineCoding::B4B5;
+    if (tenBitCode && packetBits % 8 != 0) {
+        auto corrected_payload = packetBits / 40 * 4 - 2 - sizeof(Header);
         throw std::runtime_error(std::format(
             "Invalid argument \"payload\", the \"packetBits\" should be the multiple of 8, "
             "got packetBits = {}. The most likely available \"payload\" are {} and {}.",
             payload, corrected_payload, corrected_payload + 4
         ));
     }
-    constexpr auto maxpayload = 1ull << (8 * sizeof(Header) - 1);
+    if (maxRate < 0 || maxRate > 3 || (carrierSize >> maxRate) == 0) {
+        throw std::runtime_error(std::format(
+            "Invalid argument \"maxRate\", the rate table has 4 entries and needs carrierSize >> maxRate > 0, got maxRate = {}",
+            maxRate
+        ));
+    }
+    auto frameSize = preamble.size() + packetBits * carrierSize + interSize * 2;
+    if (frameSize > sSignalBuffer.capacity()) {
+        throw std::runtime_error(std::format(
+            "Invalid argument \"sendBufferSamples\", a frame takes {} samples, got sendBufferSamples = {}",
+            frameSize, sSignalBuffer.capacity()
+        ));
+    }
+    constexpr auto maxpayload = 1ull << 19;  // width of Header::size
     if (payload >= maxpayload) {
         throw std::runtime_error(std::format(
             "Invalid argument \"payload\", \"payload\" should be smaller than {}, got payload = {}",
@@ -256,75 +438,29 @@ AsyncPhysicalLayer::AsyncPhysicalLayer(Config c)
     }
 }
 
-async auto AsyncPhysicalLayer::async_send(BitsContainer &&data) -> awaitable<void> {
+async auto AsyncPhysicalLayer::async_send(BitsContainer &&data, std::optional<uint8_t> destination) -> awaitable<void> {
     co_await boost::asio::co_spawn(senderContext, [&](BitsContainer &&data) -> awaitable<void> {
-
-        // the result after adding CRC and applying 8B10B
-        BitsContainer rawBits;
-        Header header;
-        CRC8<7> CRCChecker;
-        CRCChecker.reset();
-
-        for (auto i = 0; i < data.size() / 8; i++) {
-            // calculate real payload at the beginning of the package
-            if (i % payload == 0) {
-                header.size = std::min<int>(data.size() / 8 - i, payload);
-                header.done = (data.size() / 8 - 1) / payload == i / payload;
-                for (int j = 0; j < sizeof(Header); j++) {
-                    auto byte = ((char*)&header)[j];
-                    auto encoded = B8B10::encode(byte);
-                    rawBits.push(encoded);
-                }
-            }
-
-            // apply 8B10B to data bits
-            auto byte = data.get<8>(i);
-            CRCChecker.update(byte.to_ulong());
-            rawBits.push(B8B10::encode(byte));
-
-            // add CRC at the end of the package
-            if ((i + 1 + payload - header.size) % payload == 0) {
-                rawBits.push(B8B10::encode(std::bitset<8>(CRCChecker.get())));
-                CRCChecker.reset();
-            }
-        }
-
-        send_raw(std::move(rawBits));
+        int rate = tx_rate(destination);
+        // the result after adding CRC and applying the line code
+        auto rawBits = encode_frames(BitStream(data), rate);
+        if (auto ec = co_await send_raw(std::move(rawBits), rate))
+            std::cerr << "Send Error: " << ec.message() << std::endl;
         co_return;
     }(std::move(data)), boost::asio::use_awaitable);
     co_return;
 }
 
 
-async auto AsyncPhysicalLayer::async_send(ByteStreamBuffer &sendbuf) -> awaitable<void> {
+async auto AsyncPhysicalLayer::async_send(ByteStreamBuffer &sendbuf, std::optional<uint8_t> destination) -> awaitable<void> {
     co_await boost::asio::co_spawn(senderContext, [&](ByteStreamBuffer &sendbuf) -> awaitable<void> {
         auto q = std::span(boost::asio::buffer_cast<const uint8_t *>(sendbuf.data()), sendbuf.size());
-        BitsContainer rawBits;
-        Header header;
-        CRC8<7> CRCChecker;
-        CRCChecker.reset();
-
-        for (auto i = 0; i < q.size(); i++) {
-            if (i % payload == 0) {
-                header.size = std::min<int>(q.size() - i, payload);
-                header.done = (q.size() - 1) / payload == i / payload;
-                for (int j = 0; j < sizeof(Header); j++) {
-                    auto byte = ((char*)&header)[j];
-                    auto encoded = B8B10::encode(byte);
-                    rawBits.push(encoded);
-                }
-            }
-
-            CRCChecker.update(q[i]);
-            rawBits.push(B8B10::encode(std::bitset<8>(q[i])));
-
-            if ((i + 1 + payload - header.size) % payload == 0) {
-                rawBits.push(B8B10::encode(std::bitset<8>(CRCChecker.get())));
-                CRCChecker.reset();
-            }
-        }
+        BitStream data;
+        data.append_bytes(q);
         sendbuf.consume(q.size());
-        send_raw(std::move(rawBits));
+        int rate = tx_rate(destination);
+        auto rawBits = encode_frames(data, rate);
+        if (auto ec = co_await send_raw(std::move(rawBits), rate))
+            std::cerr << "Send Error: " << ec.message() << std::endl;
         co_return;
     }(sendbuf), boost::asio::use_awaitable);
     co_return;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include "asiocallback.hpp"
+#include "signal.hpp"
+
+namespace ASIO {
+
+    /**
+     * @brief normalize the input level before the inner handler sees it
+     *
+     * Every input channel runs through its own Signals::AGC, so the detectors and
+     * decision thresholds behind it work on a steady level whatever the volume and
+     * distance. The output is passed through untouched.
+     * The AGC raises the noise in silence up to its maximum gain, so detectors with
+     * fixed energy thresholds behind it should track the noise floor instead.
+     * e.g. AGCIOHandler(physicalLayer, Signals::AGC(0.5))
+     */
+    template<typename V = float>
+    class AGCIOHandler : public IOHandler<V> {
+
+        std::shared_ptr<IOHandler<V>> inner;
+        Signals::AGC prototype;
+        std::vector<Signals::AGC> agcs;
+        std::vector<std::vector<int>> raw;
+        std::vector<int *> ptrs;
+        std::vector<float> scratch;
+        std::atomic<float> currentGain = 1;
+
+    public:
+        AGCIOHandler(std::shared_ptr<IOHandler<V>> inner, Signals::AGC agc = {})
+            : inner(std::move(inner)), prototype(agc) { }
+
+        /** @brief gain applied to channel 0 in the last callback, for telemetry */
+        float gain() const noexcept {
+            return currentGain;
+        }
+
+        void inputCallback(const DataView<V> &p) noexcept override {
+            auto nChannels = p.getNumChannels();
+            auto nSamples = p.getNumSamples();
+            if (agcs.size() < nChannels)
+                agcs.resize(nChannels, prototype);
+            raw.resize(nChannels);
+            ptrs.resize(nChannels);
+
+            scratch.resize(nSamples);
+            for (auto c = 0; c < nChannels; c++) {
+                for (auto i = 0; i < nSamples; i++)
+                    scratch[i] = p(c, i);
+                agcs[c].process(scratch);
+                raw[c].resize(nSamples);
+                std::transform(scratch.begin(), scratch.end(), raw[c].begin(), toRawSample);
+                ptrs[c] = raw[c].data();
+            }
+            currentGain = agcs[0].gain();
+
+            inner->inputCallback(DataView<V>(ptrs.data(), nChannels, nSamples, p.getSampleRate()));
+        }
+
+        void outputCallback(DataView<V> &p) noexcept override {
+            inner->outputCallback(p);
+        }
+
+    };
+
+}
@@ -3,6 +3,8 @@
 #include "audioiohandler.hpp"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <cmath>
 
 
 namespace ASIO {
@@ -37,6 +39,18 @@ namespace ASIO {
 
     };
 
+    // a float sample in [-1, 1] as the driver's int and back, for handlers that fill raw buffers
+    // louder samples clip, at the largest float below 2^31 since 0x7fffffff rounds up to 2^31
+    inline int toRawSample(float v) noexcept {
+        constexpr float maxVal = 2147483520.f;
+        return std::lround(std::clamp(v * 0x7fffffff, -maxVal, maxVal));
+    }
+
+    inline float fromRawSample(int v) noexcept {
+        constexpr float g = 1. / 0x7fffffff;
+        return v * g;
+    }
+
     template<typename V>
     class DataView : public AudioDataProxy<int, V> {
         int *const *data;
@@ -64,6 +78,11 @@ namespace ASIO {
                 std::memset(data[i], 0, getNumSamples() * sizeof(int));
         }
 
+        // the driver buffers without the per sample conversion, for integer DSP
+        RawDataView raw() const noexcept {
+            return RawDataView(data, getNumChannels(), getNumSamples(), getSampleRate());
+        }
+
     };
 
     template<typename V>
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "asiocallback.hpp"
+#include "signal.hpp"
+
+namespace ASIO {
+
+    /**
+     * @brief run an IOHandler at its own sample rate whatever the device delivers
+     *
+     * The device side buffers are converted with Signals::Resampler and handed
+     * to the inner handler as DataView at innerRate, so the modem carriers
+     * never shift with the sound card rate.
+     * e.g. ResampledIOHandler(physicalLayer, 44100, 48000)
+     */
+    template<typename V = float>
+    class ResampledIOHandler : public IOHandler<V> {
+
+        std::shared_ptr<IOHandler<V>> inner;
+        int deviceRate, innerRate;
+        int taps;
+
+        struct Channel {
+            Signals::Resampler<float> resampler;
+            std::vector<float> samples;     // resampled signal waiting to be consumed
+            std::vector<int> raw;           // buffer behind the DataView
+        };
+        std::vector<Channel> inputChannels, outputChannels;
+        std::vector<int *> inputPtrs, outputPtrs;
+        std::vector<float> scratch;
+        size_t outputPos = 0;
+
+        // create the channel states on the first callback, later callbacks reuse them
+        void prepare(std::vector<Channel> &channels, std::vector<int *> &ptrs, size_t n, int from, int to) {
+            while (channels.size() < n)
+                channels.push_back({ Signals::Resampler<float>(from, to, taps) });
+            ptrs.resize(n);
+        }
+
+    public:
+        ResampledIOHandler(std::shared_ptr<IOHandler<V>> inner, int deviceRate, int innerRate, int taps = 32)
+            : inner(std::move(inner)), deviceRate(deviceRate), innerRate(innerRate), taps(taps) { }
+
+        void inputCallback(const DataView<V> &p) noexcept override {
+            auto nChannels = p.getNumChannels();
+            auto nSamples = p.getNumSamples();
+            prepare(inputChannels, inputPtrs, nChannels, deviceRate, innerRate);
+
+            scratch.resize(nSamples);
+            for (auto c = 0; c < nChannels; c++) {
+                auto &ch = inputChannels[c];
+                for (auto i = 0; i < nSamples; i++)
+                    scratch[i] = p(c, i);
+                ch.samples.clear();
+                ch.resampler.process(scratch, ch.samples);
+                ch.raw.resize(ch.samples.size());
+                std::transform(ch.samples.begin(), ch.samples.end(), ch.raw.begin(), toRawSample);
+                inputPtrs[c] = ch.raw.data();
+            }
+
+            auto n = inputChannels[0].samples.size();
+            if (n > 0)
+                inner->inputCallback(DataView<V>(inputPtrs.data(), nChannels, n, innerRate));
+        }
+
+        void outputCallback(DataView<V> &p) noexcept override {
+            auto nChannels = p.getNumChannels();
+            auto nSamples = p.getNumSamples();
+            prepare(outputChannels, outputPtrs, nChannels, innerRate, deviceRate);
+
+            // pull fixed size blocks from the inner handler until the device buffer can be filled
+            auto innerBlock = (nSamples * innerRate + deviceRate - 1) / deviceRate;
+            while (outputChannels[0].samples.size() - outputPos < nSamples) {
+                for (auto c = 0; c < nChannels; c++) {
+                    outputChannels[c].raw.assign(innerBlock, 0);
+                    outputPtrs[c] = outputChannels[c].raw.data();
+                }
+                auto view = DataView<V>(outputPtrs.data(), nChannels, innerBlock, innerRate);
+                inner->outputCallback(view);
+
+                scratch.resize(innerBlock);
+                for (auto c = 0; c < nChannels; c++) {
+                    auto &ch = outputChannels[c];
+                    std::transform(ch.raw.begin(), ch.raw.end(), scratch.begin(), fromRawSample);
+                    ch.resampler.process(scratch, ch.samples);
+                }
+            }
+
+            for (auto c = 0; c < nChannels; c++)
+                for (auto i = 0; i < nSamples; i++)
+                    p(c, i) = outputChannels[c].samples[outputPos + i];
+            outputPos += nSamples;
+
+            // drop the consumed samples once they outgrow the pending ones
+            if (outputPos > nSamples * 4) {
+                for (auto &ch : outputChannels)
+                    ch.samples.erase(ch.samples.begin(), ch.samples.begin() + outputPos);
+                outputPos = 0;
+            }
+        }
+
+    };
+
+}
@@ -3,9 +3,14 @@
 #include <boost/asio.hpp>
 #include <boost/asio/experimental/awaitable_operators.hpp>
 #include <iostream>
+#include <mutex>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <thread>
+#include <vector>
+
+#include "utils.hpp"
 
 using boost::asio::awaitable;
 using namespace std::chrono_literals;
@@ -39,7 +44,100 @@ class Context : public boost::asio::io_context {
     std::jthread thread;
     boost::asio::io_context::work work;
 public:
-    Context() : work(*this), thread([&] { run(); }) {}
+    // start the thread once the work guard exists, run() must never see an idle context
+    Context() : work(*this) { thread = std::jthread([&] { run(); }); }
+};
+
+
+/**
+ * @brief utils::MPMCQueue whose consumers can suspend until data arrives
+ *
+ * A coroutine waiting in async_pop parks on a steady_timer that a push
+ * expires, so no thread is held while the queue is empty. push never blocks
+ * and only takes the lock while someone is waiting.
+ * @note a waiting coroutine should run on a single threaded executor or a
+ *       strand, as Context does, since the timer is expired on its executor
+ */
+template<typename T>
+class AsyncQueue {
+    using Timer = boost::asio::steady_timer;
+
+    utils::MPMCQueue<T> queue;
+    std::mutex mtx;
+    std::vector<std::shared_ptr<Timer>> waiters;
+    std::atomic<size_t> waiting = 0;
+
+    // wake up to n waiters, each one pops for itself and may go back to sleep
+    void notify(size_t n) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) == 0)
+            return;
+        std::vector<std::shared_ptr<Timer>> woken;
+        {
+            std::lock_guard lock(mtx);
+            n = std::min(n, waiters.size());
+            woken.assign(waiters.end() - n, waiters.end());
+            waiters.resize(waiters.size() - n);
+            waiting.store(waiters.size(), std::memory_order_relaxed);
+        }
+        for (auto &timer : woken)
+            boost::asio::post(timer->get_executor(), [timer] { timer->expires_at(Timer::time_point::min()); });
+    }
+
+public:
+    explicit AsyncQueue(size_t capacity = 1024) : queue(capacity) { }
+
+    bool try_push(T &&value) {
+        if (!queue.try_push(std::move(value)))
+            return false;
+        notify(1);
+        return true;
+    }
+
+    size_t try_push_batch(std::span<T> values) {
+        auto n = queue.try_push_batch(values);
+        if (n > 0)
+            notify(n);
+        return n;
+    }
+
+    std::optional<T> try_pop() {
+        return queue.try_pop();
+    }
+
+    size_t try_pop_batch(std::span<T> out) {
+        return queue.try_pop_batch(out);
+    }
+
+    /**
+     * @brief pop the oldest element, suspend the coroutine while the queue is empty
+     */
+    awaitable<T> async_pop() {
+        for (;;) {
+            if (auto value = queue.try_pop())
+                co_return std::move(*value);
+            auto timer = std::make_shared<Timer>(co_await boost::asio::this_coro::executor, Timer::time_point::max());
+            {
+                std::lock_guard lock(mtx);
+                waiters.push_back(timer);
+                waiting.store(waiters.size(), std::memory_order_relaxed);
+            }
+            // pairs with the fence in notify, either the push sees the waiter or we see the element
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (auto value = queue.try_pop()) {
+                std::lock_guard lock(mtx);
+                std::erase(waiters, timer);
+                waiting.store(waiters.size(), std::memory_order_relaxed);
+                co_return std::move(*value);
+            }
+            boost::system::error_code ec;
+            co_await timer->async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        }
+    }
+
+    bool empty() const { return queue.empty(); }
+    size_t size() const { return queue.size(); }
+    size_t capacity() const { return queue.capacity(); }
 };
 
 
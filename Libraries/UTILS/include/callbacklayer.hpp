@@ -2,6 +2,14 @@
 #include <type_traits>
 #include <vector>
 #include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <format>
+#include <optional>
+#include <deque>
+
+#include "utils.hpp"
 
 
 namespace OSI {
@@ -74,6 +82,236 @@ public:
 };
 
 
+// statistics of one layer in the pipelined handler, written by the thread running it
+struct StageCounters {
+    std::atomic<uint64_t> upward = 0;       // batches handed to the upper layer
+    std::atomic<uint64_t> downward = 0;     // batches handed to the lower layer
+    std::atomic<uint64_t> held = 0;         // upward batches that waited for room in a full queue
+    std::atomic<uint64_t> busy_ns = 0;      // time spent in passUpper and passLower
+
+    void add_busy(std::chrono::steady_clock::time_point start) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        busy_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void report(std::ostream &os, std::string_view name) const {
+        os << std::format("{:<40} up {:>8} down {:>8} held {:>6} busy {:>10.3f} ms\n",
+            name, upward.load(), downward.load(), held.load(), busy_ns.load() / 1e6);
+    }
+};
+
+
+// one layer of the pipelined handler with its own worker thread
+// In is what the lower layer passes up, the queues between two layers are
+// single producer single consumer: inbox is filled by the lower layer and
+// drained here, outbox is filled here and drained by the lower layer
+template <class In, class T, class... Ts>
+struct PipelineStage {
+    using head = T;
+    using UpperData = decltype(std::declval<T &>().passUpper(std::declval<In &&>()));
+    using tail = PipelineStage<UpperData, Ts...>;
+    using LowerOutput = decltype(std::declval<T &>().passLower(std::declval<typename tail::LowerOutput &&>()));
+
+    head handler;
+    utils::SPSCQueue<In> inbox;
+    utils::SPSCQueue<LowerOutput> outbox;
+    StageCounters counters;
+    std::optional<UpperData> pending;   // passed up but not taken yet, the inbox waits behind it
+    tail upper;
+    std::jthread worker;    // declared last, so it starts after and stops before everything it touches
+
+    PipelineStage(size_t capacity, std::chrono::microseconds idle)
+        : inbox(capacity), outbox(capacity), upper(capacity, idle),
+          worker([this, idle](std::stop_token stop) { run(stop, idle); }) { }
+
+    // a full upper inbox holds the batch here and stops draining the inbox, so the
+    // lower layers back up instead of losing data, while the downward path goes on
+    bool step_up() {
+        if (pending) {
+            if (!upper.inbox.try_push(std::move(*pending)))
+                return false;
+            pending.reset();
+            counters.upward++;
+        }
+
+        auto input = inbox.front();
+        if (input == nullptr)
+            return false;
+        auto data = std::move(*input);
+        inbox.pop();
+
+        auto start = std::chrono::steady_clock::now();
+        auto upper_input = handler.passUpper(std::move(data));
+        counters.add_busy(start);
+        if (upper_input.size() > 0) {
+            if (upper.inbox.try_push(std::move(upper_input))) {
+                counters.upward++;
+            } else {
+                pending = std::move(upper_input);
+                counters.held++;
+            }
+        }
+        return true;
+    }
+
+    // the layer runs even without new data from above, e.g. for retransmission timers
+    bool step_down() {
+        if (outbox.size() == outbox.capacity())
+            return false;
+        typename tail::LowerOutput upper_output {};
+        bool received = false;
+        if (auto p = upper.outbox.front()) {
+            upper_output = std::move(*p);
+            upper.outbox.pop();
+            received = true;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto output = handler.passLower(std::move(upper_output));
+        counters.add_busy(start);
+        if (output.size() == 0)
+            return received;
+        outbox.try_push(std::move(output));
+        counters.downward++;
+        return true;
+    }
+
+    void run(std::stop_token stop, std::chrono::microseconds idle) {
+        while (!stop.stop_requested()) {
+            bool busy = step_up();
+            busy |= step_down();
+            if (!busy)
+                std::this_thread::sleep_for(idle);
+        }
+    }
+
+    void report(std::ostream &os) const {
+        counters.report(os, utils::get_type_name<T>());
+        upper.report(os);
+    }
+};
+
+
+// top layer
+template <class In, class T>
+struct PipelineStage<In, T> {
+    using head = T;
+    using tail = void;
+    using LowerOutput = decltype(std::declval<T &>().passLower());
+
+    head handler;
+    utils::SPSCQueue<In> inbox;
+    utils::SPSCQueue<LowerOutput> outbox;
+    StageCounters counters;
+    std::jthread worker;
+
+    PipelineStage(size_t capacity, std::chrono::microseconds idle)
+        : inbox(capacity), outbox(capacity),
+          worker([this, idle](std::stop_token stop) { run(stop, idle); }) { }
+
+    bool step_up() {
+        auto input = inbox.front();
+        if (input == nullptr)
+            return false;
+        auto data = std::move(*input);
+        inbox.pop();
+
+        auto start = std::chrono::steady_clock::now();
+        handler.passUpper(std::move(data));
+        counters.add_busy(start);
+        counters.upward++;
+        return true;
+    }
+
+    bool step_down() {
+        if (outbox.size() == outbox.capacity())
+            return false;
+        auto start = std::chrono::steady_clock::now();
+        auto output = handler.passLower();
+        counters.add_busy(start);
+        if (output.size() == 0)
+            return false;
+        outbox.try_push(std::move(output));
+        counters.downward++;
+        return true;
+    }
+
+    void run(std::stop_token stop, std::chrono::microseconds idle) {
+        while (!stop.stop_requested()) {
+            bool busy = step_up();
+            busy |= step_down();
+            if (!busy)
+                std::this_thread::sleep_for(idle);
+        }
+    }
+
+    void report(std::ostream &os) const {
+        counters.report(os, utils::get_type_name<T>());
+    }
+};
+
+
+// same layers as MultiLayerIOHandler, but only the lowest one runs in the audio
+// callbacks. every layer above has its own worker thread and talks to its
+// neighbours through bounded lock-free queues, so slow upper layers (file I/O,
+// retransmission) can neither stall the audio thread nor each other.
+// a full queue never drops an upward batch: a worker holds it and stops taking
+// input until there is room, the audio thread, which cannot wait, keeps it in
+// order in a backlog. the downward path only runs a layer when the queue below
+// it has room
+template <class T, class... Ts>
+class PipelinedMultiLayerIOHandler : public IOHandler<float> {
+public:
+    using UpperData = decltype(std::declval<T &>().passUpper(std::declval<DataView<float> &&>()));
+    using Upper = PipelineStage<UpperData, Ts...>;
+
+    T handler;
+    StageCounters counters;
+    std::deque<UpperData> backlog;  // upward batches waiting for room, oldest first
+    Upper upper;
+
+    explicit PipelinedMultiLayerIOHandler(size_t capacity = 64, std::chrono::microseconds idle = std::chrono::microseconds(500))
+        : upper(capacity, idle) { }
+
+    void outputCallback(DataView<float> &p) noexcept override {
+        auto start = std::chrono::steady_clock::now();
+        typename Upper::LowerOutput upper_output {};
+        if (auto q = upper.outbox.front()) {
+            upper_output = std::move(*q);
+            upper.outbox.pop();
+            counters.downward++;
+        }
+        handler.passLower(std::move(upper_output), p);
+        counters.add_busy(start);
+    }
+
+    void inputCallback(DataView<float> &&p) noexcept override {
+        auto start = std::chrono::steady_clock::now();
+        auto upper_input = handler.passUpper(std::move(p));
+        if (upper_input.size() > 0) {
+            if (!backlog.empty() || !upper.inbox.try_push(std::move(upper_input))) {
+                backlog.push_back(std::move(upper_input));
+                counters.held++;
+            } else {
+                counters.upward++;
+            }
+        }
+        while (!backlog.empty() && upper.inbox.try_push(std::move(backlog.front()))) {
+            backlog.pop_front();
+            counters.upward++;
+        }
+        counters.add_busy(start);
+    }
+
+    // one line per layer, from the physical layer up
+    void report(std::ostream &os = std::cout) const {
+        counters.report(os, utils::get_type_name<T>());
+        upper.report(os);
+    }
+
+};
+
+
 } // namespace OSI
 
 
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define UTILS_FILEIO_WIN32
+#elif __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define UTILS_FILEIO_MMAP
+#endif
+
+namespace utils {
+
+    // a whole file as read only memory, mapped with MapViewOfFile on Windows and
+    // mmap elsewhere, read with a single call where neither exists. a file that
+    // cannot be opened is empty
+    class MappedFile {
+        const char *ptr = nullptr;
+        size_t length = 0;
+        bool opened = false;
+    #if !defined(UTILS_FILEIO_WIN32) && !defined(UTILS_FILEIO_MMAP)
+        std::vector<char> buffer;
+    #endif
+
+    public:
+        explicit MappedFile(const std::string &fileName) {
+        #if defined(UTILS_FILEIO_WIN32)
+            auto file = ::CreateFileW(std::filesystem::path(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                      nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return;
+            opened = true;
+            LARGE_INTEGER size;
+            if (::GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+                auto mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping != nullptr) {
+                    auto p = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                    if (p != nullptr) {
+                        ptr = (const char *)p;
+                        length = size.QuadPart;
+                    }
+                    // the view keeps the mapping alive
+                    ::CloseHandle(mapping);
+                }
+            }
+            ::CloseHandle(file);
+        #elif defined(UTILS_FILEIO_MMAP)
+            auto fd = ::open(fileName.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            opened = true;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                auto p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+                    ptr = (const char *)p;
+                    length = st.st_size;
+                }
+            }
+            ::close(fd);
+        #else
+            std::ifstream file { fileName, std::ios::binary | std::ios::ate };
+            if (!file.is_open())
+                return;
+            opened = true;
+            buffer.resize(file.tellg());
+            file.seekg(0);
+            file.read(buffer.data(), buffer.size());
+            ptr = buffer.data();
+            length = file.gcount();
+        #endif
+        }
+
+        ~MappedFile() {
+        #if defined(UTILS_FILEIO_WIN32)
+            if (ptr != nullptr)
+                ::UnmapViewOfFile(ptr);
+        #elif defined(UTILS_FILEIO_MMAP)
+            if (ptr != nullptr)
+                ::munmap((void *)ptr, length);
+        #endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool is_open() const { return opened; }
+        const char *data() const { return ptr; }
+        size_t size() const { return length; }
+        std::string_view text() const { return { ptr, length }; }
+        std::span<const uint8_t> bytes() const { return { (const uint8_t *)ptr, length }; }
+    };
+
+
+    namespace detail {
+
+        inline bool is_space(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+        }
+
+        // append the numbers in [first, last) to out, return where parsing stopped
+        // like ifstream >> it stops at the first token that is not a number, and
+        // a bool is a 0 or a 1
+        template<typename Container>
+        const char *parse_numbers(const char *first, const char *last, Container &out) {
+            using T = typename Container::value_type;
+            for (;;) {
+                while (first != last && is_space(*first))
+                    first++;
+                if (first == last)
+                    return first;
+                if constexpr (std::is_same_v<T, bool>) {
+                    // one bit per token is the common case, skip from_chars for it
+                    if ((*first == '0' || *first == '1') && (first + 1 == last || is_space(first[1]))) {
+                        out.push_back(*first++ == '1');
+                        continue;
+                    }
+                    int v;
+                    auto [p, ec] = std::from_chars(first, last, v);
+                    if (ec != std::errc() || (v != 0 && v != 1))
+                        return first;
+                    out.push_back(v);
+                    first = p;
+                } else {
+                    // from_chars rejects the leading plus ifstream accepts
+                    auto start = *first == '+' && last - first > 1 && first[1] != '-' ? first + 1 : first;
+                    T v;
+                    auto [p, ec] = std::from_chars(start, last, v);
+                    if (ec != std::errc())
+                        return first;
+                    out.push_back(v);
+                    first = p;
+                }
+            }
+        }
+
+    }
+
+    // whitespace separated numbers, threads > 1 cuts the text at whitespace and
+    // parses the chunks side by side. the result is the same as a single pass
+    template<typename Container>
+    inline Container parse_numbers(std::string_view text, size_t threads = 1) {
+        Container out;
+        auto first = text.data(), last = text.data() + text.size();
+        threads = std::max<size_t>(1, std::min<size_t>(threads, text.size() / (1 << 16)));
+        if (threads == 1) {
+            detail::parse_numbers(first, last, out);
+            return out;
+        }
+
+        std::vector<const char *> cuts { first };
+        for (size_t i = 1; i < threads; i++) {
+            auto p = std::max(cuts.back(), first + text.size() * i / threads);
+            while (p != last && !detail::is_space(*p))
+                p++;
+            cuts.push_back(p);
+        }
+        cuts.push_back(last);
+
+        std::vector<Container> parts(threads);
+        std::vector<const char *> stops(threads);
+        {
+            std::vector<std::jthread> workers;
+            for (size_t i = 0; i < threads; i++)
+                workers.emplace_back([&, i] { stops[i] = detail::parse_numbers(cuts[i], cuts[i + 1], parts[i]); });
+        }
+        // a chunk that stopped early ends the sequence, as it would in one pass
+        size_t n = 0;
+        for (auto &part : parts)
+            n += part.size();
+        out.reserve(n);
+        for (size_t i = 0; i < threads; i++) {
+            out.insert(out.end(), parts[i].begin(), parts[i].end());
+            if (stops[i] != cuts[i + 1])
+                break;
+        }
+        return out;
+    }
+
+    // raw values in native byte order, as to_bin writes them
+    template<typename T> requires (std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>)
+    inline std::vector<T> from_bin(std::string fileName) {
+        MappedFile file(fileName);
+        if (!file.is_open())
+            throw std::runtime_error("Cannot open file: " + fileName);
+        std::vector<T> container(file.size() / sizeof(T));
+        std::memcpy(container.data(), file.data(), container.size() * sizeof(T));
+        return container;
+    }
+
+    template<typename T> requires (std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>)
+    inline void to_bin(std::string fileName, std::span<const T> values) {
+        std::ofstream dataFile { fileName, std::ios::binary };
+        dataFile.write((const char *)values.data(), values.size_bytes());
+    }
+
+}
@@ -12,16 +12,20 @@ class FixPoint {
 public:
     FixPoint() : data{} { }
     FixPoint(int v) : data(v << N) { }
-    FixPoint(float v) : data(v * std::numeric_limits<int>::max()) { }
+    FixPoint(float v) : data(v * (1 << N)) { }
     FixPoint(const FixPoint&) noexcept = default;
     FixPoint(FixPoint&&) noexcept = default;
     FixPoint& operator=(const FixPoint&) noexcept = default;
     FixPoint& operator=(FixPoint&&) noexcept = default;
+    // the underlying Q format integer, e.g. for the integer kernels in signal.hpp
+    static FixPoint from_raw(int v) noexcept { FixPoint f; f.data = v; return f; }
+    int raw() const noexcept { return data; }
+
     FixPoint& operator=(int v) noexcept { return (data = v << N), *this; }
     FixPoint& operator+=(const FixPoint& v) noexcept { return (data += v.data), *this; }
     FixPoint& operator-=(const FixPoint& v) noexcept { return (data -= v.data), *this; }
-    FixPoint& operator*=(const FixPoint& v) noexcept { return ((data >>= 14) *= v.data), *this; }
-    FixPoint& operator/=(const FixPoint& v) noexcept { return ((data <<= 14) /= v.data), *this; }
+    FixPoint& operator*=(const FixPoint& v) noexcept { return (data = (long long)data * v.data >> N), *this; }
+    FixPoint& operator/=(const FixPoint& v) noexcept { return (data = ((long long)data << N) / v.data), *this; }
     FixPoint& operator+=(int v) noexcept { return (data += v << N), *this; }
     FixPoint& operator-=(int v) noexcept { return (data -= v << N), *this; }
     FixPoint& operator*=(int v) noexcept { return (data *= v), *this; }
@@ -40,7 +44,7 @@ public:
     FixPoint operator*(auto v) const noexcept { return FixPoint(*this) *= v; }
     FixPoint operator/(auto v) const noexcept { return FixPoint(*this) /= v; }
 
-    FixPoint operator-() const noexcept { return FixPoint(-data); }
+    FixPoint operator-() const noexcept { return from_raw(-data); }
     auto operator<=>(const FixPoint&) const noexcept = default;
 
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTILS_FRAMING_SSE2
+#endif
+
+#include "utils.hpp"
+
+namespace utils {
+
+    // the first byte equal to a or b in [first, last), or last
+    // memchr style, 16 bytes per step with SSE2 and 8 bytes per step in a
+    // 64 bit word elsewhere, so clean runs are skipped instead of branched over
+    inline const uint8_t *find_either(const uint8_t *first, const uint8_t *last, uint8_t a, uint8_t b) {
+    #ifdef UTILS_FRAMING_SSE2
+        auto va = _mm_set1_epi8((char)a), vb = _mm_set1_epi8((char)b);
+        for (; last - first >= 16; first += 16) {
+            auto v = _mm_loadu_si128((const __m128i *)first);
+            auto m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+            if (m != 0)
+                return first + std::countr_zero((unsigned)m);
+        }
+    #endif
+        if constexpr (std::endian::native == std::endian::little) {
+            constexpr uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+            // marks the zero bytes of x, exact up to the lowest one
+            auto zeros = [](uint64_t x) { return (x - ones) & ~x & highs; };
+            for (; last - first >= 8; first += 8) {
+                uint64_t w;
+                std::memcpy(&w, first, sizeof(w));
+                auto m = zeros(w ^ (ones * a)) | zeros(w ^ (ones * b));
+                if (m != 0)
+                    return first + std::countr_zero(m) / CHAR_BIT;
+            }
+        }
+        for (; first != last; first++)
+            if (*first == a || *first == b)
+                return first;
+        return last;
+    }
+
+
+    // consistent overhead byte stuffing: no zero byte in the output, at most
+    // one extra byte per 254, so a frame only grows by a bounded amount
+    inline void cobs_encode(std::span<const uint8_t> input, ByteContainer &output) {
+        auto p = input.data(), e = p + input.size();
+        for (;;) {
+            auto limit = p + std::min<ptrdiff_t>(254, e - p);
+            auto q = (const uint8_t *)std::memchr(p, 0, limit - p);
+            if (q == nullptr)
+                q = limit;
+            output.push_back(uint8_t(q - p + 1));
+            output.insert(output.end(), p, q);
+            if (q == e)
+                return;
+            // a full block of 254 has no zero behind it
+            p = q - p == 254 ? q : q + 1;
+        }
+    }
+
+    // decode one frame without its delimiter, false if it is malformed
+    inline bool cobs_decode(std::span<const uint8_t> input, PacketBuffer &output) {
+        auto p = input.data(), e = p + input.size();
+        while (p != e) {
+            auto code = *p++;
+            if (code == 0 || code - 1 > e - p)
+                return false;
+            output.append({ p, size_t(code - 1) });
+            p += code - 1;
+            if (code != 0xff && p != e)
+                output.push_back(0);
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <bitset>
+#include <cstdint>
+
+#include "utils.hpp"
+#include "8b10b.h"
+
+namespace utils {
+
+    // line codes for the NRZ physical layer, byte in, line bits out
+    // every code word is appended to the BitStream in one go
+    // a frame resets both ends, encoder and decoder state are independent
+    // so one object can serve a sender and a receiver thread at once
+    class LineCode {
+    public:
+        virtual ~LineCode() = default;
+
+        // line bits of the first n bytes of a frame
+        virtual size_t bits(size_t bytes) const = 0;
+
+        virtual void reset_encoder() = 0;
+        virtual void encode(uint8_t byte, BitStream &out) = 0;
+
+        virtual void reset_decoder() = 0;
+        // push one received bit, return the byte it completes
+        // throws on a code word the encoder never produces (misdetected frame)
+        virtual std::optional<uint8_t> decode(bool bit) = 0;
+    };
+
+    enum class LineCoding {
+        B8B10,          // 25% overhead, DC balanced
+        B4B5,           // 25% overhead, NRZI so a polarity flip costs one code group
+        Scrambled,      // 64b/66b style, 3% overhead, needs a decent DC response
+        Manchester,     // 100% overhead, a transition in every bit for very noisy links
+    };
+
+
+    // the B8B10 maps flattened into arrays, instead of a hash lookup per byte
+    class B8B10Code final : public LineCode {
+        static const std::array<uint16_t, 256> &encoding() {
+            static const auto table = [] {
+                std::array<uint16_t, 256> t {};
+                for (int i = 0; i < 256; i++)
+                    t[i] = B8B10::encode(i).to_ulong();
+                return t;
+            }();
+            return table;
+        }
+        static const std::array<int16_t, 1024> &decoding() {
+            static const auto table = [] {
+                std::array<int16_t, 1024> t {};
+                t.fill(-1);
+                for (int i = 0; i < 256; i++)
+                    t[encoding()[i]] = i;
+                return t;
+            }();
+            return table;
+        }
+
+        const std::array<uint16_t, 256> &encodeTable = encoding();
+        const std::array<int16_t, 1024> &decodeTable = decoding();
+        uint16_t word = 0;
+        int n = 0;
+    public:
+        size_t bits(size_t bytes) const override { return bytes * 10; }
+
+        void reset_encoder() override { }
+        void encode(uint8_t byte, BitStream &out) override {
+            out.append_bits(encodeTable[byte], 10);
+        }
+
+        void reset_decoder() override { n = 0; word = 0; }
+        std::optional<uint8_t> decode(bool bit) override {
+            word |= bit << n++;
+            if (n < 10)
+                return {};
+            auto byte = decodeTable[word];
+            n = 0;
+            word = 0;
+            if (byte < 0)
+                throw std::runtime_error("invalid 8B10B code word");
+            return (uint8_t)byte;
+        }
+    };
+
+
+    // 4B5B code groups sent NRZI, a one toggles the line level
+    // a frame starts from level 0 on both ends, so an inverted line breaks the first
+    // code group and a flip inside the frame the group it lands in, the rest decode
+    // as sent. the preamble only matches with the right polarity, which keeps the
+    // first group safe behind AsyncPhysicalLayer
+    class B4B5Code final : public LineCode {
+        static constexpr std::array<uint8_t, 16> table = {
+            0b11110, 0b01001, 0b10100, 0b10101, 0b01010, 0b01011, 0b01110, 0b01111,
+            0b10010, 0b10011, 0b10110, 0b10111, 0b11010, 0b11011, 0b11100, 0b11101,
+        };
+        static constexpr std::array<int8_t, 32> inverse = [] {
+            std::array<int8_t, 32> inv {};
+            inv.fill(-1);
+            for (int i = 0; i < 16; i++)
+                inv[table[i]] = i;
+            return inv;
+        }();
+        // line levels of each code group starting from level 0, in send order
+        static constexpr std::array<uint8_t, 16> levels = [] {
+            std::array<uint8_t, 16> l {};
+            for (int i = 0; i < 16; i++) {
+                bool level = false;
+                for (int k = 0; k < 5; k++)
+                    l[i] |= (level ^= (table[i] >> (4 - k)) & 1) << k;
+            }
+            return l;
+        }();
+
+        bool sendLevel = false, receiveLevel = false;
+        uint8_t word = 0, byte = 0;
+        int n = 0;
+
+    public:
+        size_t bits(size_t bytes) const override { return bytes * 10; }
+
+        void reset_encoder() override { sendLevel = false; }
+        void encode(uint8_t byte, BitStream &out) override {
+            uint64_t code = 0;
+            for (int i = 0; i < 2; i++) {
+                auto l = levels[(byte >> (4 * i)) & 0xf] ^ (sendLevel ? 0x1f : 0);
+                code |= uint64_t(l) << (5 * i);
+                sendLevel = l >> 4;
+            }
+            out.append_bits(code, 10);
+        }
+
+        void reset_decoder() override { receiveLevel = false; n = 0; word = 0; byte = 0; }
+        std::optional<uint8_t> decode(bool level) override {
+            word = word << 1 | (level != receiveLevel);
+            receiveLevel = level;
+            if (++n % 5)
+                return {};
+            auto nibble = inverse[word & 0x1f];
+            if (nibble < 0)
+                throw std::runtime_error("invalid 4B5B code group");
+            word = 0;
+            if (n == 5) {
+                byte = nibble;
+                return {};
+            }
+            n = 0;
+            return uint8_t(byte | nibble << 4);
+        }
+    };
+
+
+    // self-synchronizing scrambler x^58 + x^39 + 1 as in 64b/66b, with a 01 sync
+    // header in front of every 8 bytes. the header is never scrambled, so a
+    // misdetected frame shows up as a broken sync header
+    class ScrambledCode final : public LineCode {
+        static constexpr uint64_t seed = 0x2b9f1e4c7d3a615ull;   // any 58 bit pattern, so runs of zeros still toggle
+        uint64_t sendState = seed, receiveState = seed;
+        size_t sent = 0;
+        int n = 0;
+        uint8_t byte = 0;
+
+        static bool feedback(uint64_t s) { return ((s >> 38) ^ (s >> 57)) & 1; }
+
+    public:
+        size_t bits(size_t bytes) const override { return bytes * 8 + (bytes + 7) / 8 * 2; }
+
+        void reset_encoder() override { sendState = seed; sent = 0; }
+        void encode(uint8_t b, BitStream &out) override {
+            if (sent++ % 8 == 0)
+                out.append_bits(0b10, 2);
+            uint64_t scrambled = 0;
+            for (int i = 0; i < 8; i++) {
+                bool s = ((b >> i) & 1) ^ feedback(sendState);
+                sendState = sendState << 1 | s;
+                scrambled |= uint64_t(s) << i;
+            }
+            out.append_bits(scrambled, 8);
+        }
+
+        void reset_decoder() override { receiveState = seed; n = 0; byte = 0; }
+        std::optional<uint8_t> decode(bool bit) override {
+            // position in the 66 bit block, 0 and 1 are the sync header
+            auto i = n++ % 66;
+            if (i < 2) {
+                if (bit != (i == 1))
+                    throw std::runtime_error("lost 64b/66b block sync");
+                return {};
+            }
+            byte |= (bit ^ feedback(receiveState)) << (i - 2) % 8;
+            receiveState = receiveState << 1 | bit;
+            if ((i - 2) % 8 < 7)
+                return {};
+            auto b = byte;
+            byte = 0;
+            return b;
+        }
+    };
+
+
+    // 0 is sent as high-low, 1 as low-high
+    class ManchesterCode final : public LineCode {
+        bool first = false;
+        int n = 0;
+        uint8_t byte = 0;
+    public:
+        size_t bits(size_t bytes) const override { return bytes * 16; }
+
+        void reset_encoder() override { }
+        void encode(uint8_t b, BitStream &out) override {
+            // spread the bits to the odd positions, the complements go in between
+            uint64_t x = b;
+            x = (x | x << 4) & 0x0f0f;
+            x = (x | x << 2) & 0x3333;
+            x = (x | x << 1) & 0x5555;
+            out.append_bits((x << 1) | (~x & 0x5555), 16);
+        }
+
+        void reset_decoder() override { n = 0; byte = 0; }
+        std::optional<uint8_t> decode(bool bit) override {
+            if (n++ % 2 == 0) {
+                first = bit;
+                return {};
+            }
+            if (first == bit)
+                throw std::runtime_error("missing Manchester transition");
+            byte |= bit << (n / 2 - 1);
+            if (n < 16)
+                return {};
+            auto b = byte;
+            n = 0;
+            byte = 0;
+            return b;
+        }
+    };
+
+
+    inline std::unique_ptr<LineCode> make_line_code(LineCoding coding) {
+        switch (coding) {
+            case LineCoding::B4B5: return std::make_unique<B4B5Code>();
+            case LineCoding::Scrambled: return std::make_unique<ScrambledCode>();
+            case LineCoding::Manchester: return std::make_unique<ManchesterCode>();
+            default: return std::make_unique<B8B10Code>();
+        }
+    }
+
+}
@@ -6,9 +6,82 @@
 #include <valarray>
 #include <complex>
 #include <algorithm>
+#include <span>
+#include <numeric>
+#include <optional>
+#include <cstdint>
+
+#include "fix_point.hpp"
 
 namespace Signals {
 
+    // numerically controlled oscillator
+    // the carrier is produced by rotating a unit phasor, so every sample costs
+    // one complex multiply instead of a call to std::sin / std::cos
+    class NCO {
+        std::complex<double> phasor;    // e^{j * phase} of the current sample
+        std::complex<double> step;      // rotation from the current sample to the next one
+        std::complex<double> sweep;     // rotation applied to step every sample (chirp)
+        int tick = 0;
+
+        static constexpr int renormalize_period = 512;
+
+        void advance() noexcept {
+            phasor *= step;
+            step *= sweep;
+            if (++tick % renormalize_period == 0) {
+                // first order correction keeps |phasor| = 1 against rounding error
+                phasor *= 1.5 - 0.5 * std::norm(phasor);
+                step *= 1.5 - 0.5 * std::norm(step);
+            }
+        }
+
+    public:
+        // omega : normalized frequency (cycles per sample)
+        // phase : initial phase (rad)
+        // rate  : change of omega per sample, nonzero for a linear chirp
+        NCO(double omega, double phase = 0, double rate = 0)
+            : phasor(std::polar(1., phase)),
+              step(std::polar(1., 2 * std::numbers::pi * (omega + rate / 2))),
+              sweep(std::polar(1., 2 * std::numbers::pi * rate)) { }
+
+        std::complex<float> next() noexcept {
+            auto z = std::complex<float>(phasor);
+            advance();
+            return z;
+        }
+
+        void render(std::span<float> cos, std::span<float> sin) noexcept {
+            for (auto i = 0; i < cos.size(); i++) {
+                cos[i] = phasor.real();
+                sin[i] = phasor.imag();
+                advance();
+            }
+        }
+
+        void render_sin(std::span<float> out) noexcept {
+            for (auto i = 0; i < out.size(); i++) {
+                out[i] = phasor.imag();
+                advance();
+            }
+        }
+
+        void render_cos(std::span<float> out) noexcept {
+            for (auto i = 0; i < out.size(); i++) {
+                out[i] = phasor.real();
+                advance();
+            }
+        }
+
+        // cos and sin tables of the first size samples
+        static auto table(double omega, int size, double phase = 0) {
+            std::pair<std::vector<float>, std::vector<float>> t { size, size };
+            NCO(omega, phase).render(t.first, t.second);
+            return t;
+        }
+
+    };
+
     auto time_vector(float duration, float fs = 48000) {
         std::vector<float> t(duration * fs);
         for (auto i = 0; i < duration * fs; i++) t[i] = i / fs;
@@ -34,6 +107,11 @@ namespace Signals {
             return std::sin(2 * std::numbers::pi * ((freq_end - freq_start) / 2 * t / duration + freq_start) * t + phase);
         }
 
+        // fill out with samples at t = 0, 1/fs, 2/fs, ...
+        void render(std::span<float> out, float fs = 48000) {
+            NCO(freq_start / fs, phase, (freq_end - freq_start) / duration / fs / fs).render_sin(out);
+        }
+
     };
 
     class Hamming {
@@ -143,6 +221,375 @@ namespace Signals {
     };
 
 
+    // inner product with independent partial sums, so the loop vectorizes
+    // without relying on -ffast-math reassociation
+    template<typename T>
+    inline T dot(const T *a, const T *b, int n) noexcept {
+        constexpr int W = 8;
+        T acc[W] {};
+        int i = 0;
+        for (; i + W <= n; i += W)
+            for (int k = 0; k < W; k++)
+                acc[k] += a[i + k] * b[i + k];
+        T sum = 0;
+        for (; i < n; i++)
+            sum += a[i] * b[i];
+        for (int k = 0; k < W; k++)
+            sum += acc[k];
+        return sum;
+    }
+
+
+    // Q15 integer kernels for the fixed point receive path, written as plain loops over
+    // int16 so the compiler emits packed multiplies (pmulhw / vqdmulh) without intrinsics
+
+    // Q31 driver samples to Q15, shift < 16 adds digital gain and saturates
+    inline void to_q15(const int *in, int16_t *out, int n, int shift = 16) noexcept {
+        for (int i = 0; i < n; i++)
+            out[i] = (int16_t)std::clamp(in[i] >> shift, -32768, 32767);
+    }
+
+    // sum of the Q15 products, saturated to the int range of FixPoint<15>
+    // each product is rounded to Q15 before accumulating, so an int32 lane holds 65535
+    // full scale terms; the lanes are flushed into a 64 bit sum before they can wrap
+    inline FixPoint<15> dot_q15(const int16_t *a, const int16_t *b, int n) noexcept {
+        constexpr int W = 16;
+        constexpr int block = 65535 * W;
+        int64_t sum = 0;
+        int i = 0;
+        while (n - i >= W) {
+            int acc[W] {};
+            auto end = i + std::min(n - i, block) / W * W;
+            for (; i < end; i += W)
+                for (int k = 0; k < W; k++)
+                    acc[k] += (a[i + k] * b[i + k]) >> 15;
+            for (int k = 0; k < W; k++)
+                sum += acc[k];
+        }
+        for (; i < n; i++)
+            sum += (a[i] * b[i]) >> 15;
+        return FixPoint<15>::from_raw((int)std::clamp<int64_t>(sum, INT32_MIN, INT32_MAX));
+    }
+
+    inline FixPoint<15> energy_q15(const int16_t *a, int n) noexcept {
+        return dot_q15(a, a, n);
+    }
+
+    // sum of x^2 for x = raw / 32768, in the units of the float path so both compare against
+    // the same thresholds. the raw products are summed exactly and scaled by 32768^2 at the end,
+    // energy_q15 rounds each one to Q15 and loses the quiet signals below 2^-7.5 full scale
+    inline float energy_from_q15(const int16_t *a, int n) noexcept {
+        int64_t sum = 0;
+        for (int i = 0; i < n; i++)
+            sum += a[i] * a[i];
+        return sum * (1.f / (1 << 30));
+    }
+
+    // float signal to Q15 scaled by 1 / scale, scale is the peak so nothing saturates
+    inline std::vector<int16_t> to_q15(std::span<const float> in, float scale) {
+        std::vector<int16_t> out(in.size());
+        for (size_t i = 0; i < in.size(); i++)
+            out[i] = (int16_t)std::clamp(FixPoint<15>(in[i] / scale).raw(), -32768, 32767);
+        return out;
+    }
+
+
+    // polyphase FIR sample rate converter with rational ratio fs_out / fs_in = L / M
+    // (e.g. 44100 -> 48000 is L = 160, M = 147; 48000 -> 16000 is a plain decimation by 3)
+    template <typename T = float>
+    class Resampler {
+        int L, M;               // interpolation and decimation factor
+        int taps;               // taps per phase
+        std::vector<T> bank;    // L filters of taps coefficients, each reversed for dot()
+        std::vector<T> history; // input samples still needed by later outputs
+        long long t;            // position of the next output on the L-times upsampled grid of history
+
+    public:
+        Resampler(int fs_in, int fs_out, int taps = 32) : taps(taps) {
+            auto g = std::gcd(fs_in, fs_out);
+            L = fs_out / g;
+            M = fs_in / g;
+
+            // windowed sinc lowpass at the upsampled rate, cut below the lower nyquist
+            int N = L * taps;
+            double fc = 0.45 / std::max(L, M);
+            std::vector<double> h(N);
+            for (int n = 0; n < N; n++) {
+                double x = n - (N - 1) / 2.;
+                double sinc = x == 0 ? 2 * fc : std::sin(2 * std::numbers::pi * fc * x) / (std::numbers::pi * x);
+                double window = 0.42 - 0.5 * std::cos(2 * std::numbers::pi * n / (N - 1)) + 0.08 * std::cos(4 * std::numbers::pi * n / (N - 1));
+                h[n] = L * sinc * window;
+            }
+
+            bank.resize(N);
+            for (int p = 0; p < L; p++)
+                for (int k = 0; k < taps; k++)
+                    bank[p * taps + k] = h[(taps - 1 - k) * L + p];
+
+            reset();
+        }
+
+        void reset() {
+            history.assign(taps - 1, T(0));
+            t = (long long)(taps - 1) * L;
+        }
+
+        // upper bound of the number of outputs produced by n inputs
+        size_t max_output(size_t n) const {
+            return (n * L + M - 1) / M + 1;
+        }
+
+        // resample the next chunk of a continuous signal, the outputs are appended to out
+        void process(std::span<const T> in, std::vector<T> &out) {
+            history.insert(history.end(), in.begin(), in.end());
+            for (long long i; (i = t / L) < (long long)history.size(); t += M) {
+                auto p = t % L;
+                out.push_back(dot(&bank[p * taps], &history[i - taps + 1], taps));
+            }
+            auto consumed = t / L - (taps - 1);
+            history.erase(history.begin(), history.begin() + consumed);
+            t -= consumed * L;
+        }
+
+        auto ratio() const { return std::pair { L, M }; }
+
+    };
+
+    // adaptive FIR equalizer trained with normalized LMS
+    // y[i] = sum_k w[k] x[i + delay - k], the delay lets the filter cancel pre-cursors too.
+    // usage per block: push(x), output() for the decision, then train(desired) with the
+    // known (training) or decided (decision directed) transmitted signal
+    template <typename T = float>
+    class Equalizer {
+        int size, delay;
+        T mu;
+        std::vector<T> taps;        // reversed, so an output is dot(taps, window)
+        std::vector<T> window;      // size - 1 previous inputs, the current block, delay zeros
+        int n = 0;                  // length of the current block
+
+    public:
+        Equalizer(int size, T mu = 0.05) : size(size), delay(size / 2), mu(mu), window(size - 1) {
+            reset();
+        }
+
+        void reset() {
+            taps.assign(size, T(0));
+            taps[size - 1 - delay] = 1;
+            std::fill(window.begin(), window.end(), T(0));
+            window.resize(size - 1);
+            n = 0;
+        }
+
+        void push(std::span<const T> x) {
+            // keep the tail of the previous block as history
+            if (n > 0)
+                std::copy(window.begin() + n, window.begin() + n + size - 1, window.begin());
+            n = x.size();
+            window.resize(size - 1 + n + delay);
+            std::copy(x.begin(), x.end(), window.begin() + size - 1);
+            std::fill(window.end() - delay, window.end(), T(0));
+        }
+
+        std::vector<T> output() const {
+            std::vector<T> y(n);
+            for (auto i = 0; i < n; i++)
+                y[i] = dot(taps.data(), &window[i + delay], size);
+            return y;
+        }
+
+        // NLMS passes over the current block (outputs that would need future inputs are skipped)
+        void train(std::span<const T> desired, int passes = 1) {
+            auto m = std::min<int>(desired.size(), n - delay);
+            for (auto pass = 0; pass < passes; pass++)
+            for (auto i = 0; i < m; i++) {
+                auto u = &window[i + delay];
+                auto e = desired[i] - dot(taps.data(), u, size);
+                auto g = mu * e / (dot(u, u, size) + T(1e-6));
+                for (auto k = 0; k < size; k++)
+                    taps[k] += g * u[k];
+            }
+        }
+
+    };
+
+    // symbol timing recovery for rectangular (NRZ) symbols of a nominal period
+    // the symbols are integrated on a fractional grid (linear interpolation of the running sum),
+    // and the grid is steered by a Gardner timing error detector, so a timing offset
+    // at the start of a frame is pulled in instead of accumulating over it.
+    // the second order term tracks the symbol period itself, i.e. the sample clock
+    // offset between sender and receiver, which is reported in ppm
+    class TimingRecovery {
+        int base;                   // nominal period restored by reset
+        double nominal;
+        double period;              // current estimate of the symbol period
+        double gain;                // phase gain, 0 keeps the initial grid
+        double drift_gain;          // period gain, 0 keeps the period fixed
+        std::vector<double> cumsum; // ring of running sums, cumsum[n % size] = x[0] + ... + x[n - 1]
+        double acc;
+        long long n;                // samples pushed since reset
+        long long count;            // symbols emitted since reset
+        double strobe;              // position of the end of the next symbol
+        double last;                // integral of the previous symbol
+        double anchor;              // strobe once the loop has settled, for the clock offset measurement
+
+        double at(double pos) const {
+            auto i = (long long)std::floor(pos);
+            auto f = pos - i;
+            auto c0 = cumsum[i % cumsum.size()];
+            auto c1 = cumsum[(i + 1) % cumsum.size()];
+            return c0 + f * (c1 - c0);
+        }
+
+    public:
+        TimingRecovery(int period, float gain = 0.1, float drift_gain = 0)
+            : base(period), nominal(period), period(period), gain(gain), drift_gain(drift_gain), cumsum(2 * period + 4) {
+            reset();
+        }
+
+        void reset() {
+            nominal = base;
+            period = nominal;
+            acc = 0;
+            n = 0;
+            count = 0;
+            cumsum[0] = 0;
+            strobe = period;
+            last = 0;
+            anchor = 0;
+        }
+
+        // push one sample, return the integral of a symbol when one is complete
+        std::optional<float> push(float x) {
+            acc += x;
+            cumsum[++n % cumsum.size()] = acc;
+            if (n <= strobe)
+                return {};
+
+            auto y = at(strobe) - at(strobe - period);
+            if (gain > 0 && count > 0 && strobe >= 1.5 * period) {
+                // the midpoint integral is zero when the grid sits on the transition
+                auto mid = at(strobe - period / 2) - at(strobe - period * 3 / 2);
+                auto e = std::clamp((last - y) * mid / (last * last + y * y + 1e-12), -0.5, 0.5);
+                strobe += gain * period / 2 * e;
+                period = std::clamp(period + drift_gain * period / 2 * e, nominal * (1 - max_ppm * 1e-6), nominal * (1 + max_ppm * 1e-6));
+            }
+            last = y;
+            if (++count == settle)
+                anchor = strobe;
+            strobe += period;
+            return y;
+        }
+
+        static constexpr double max_ppm = 10000;
+        static constexpr long long settle = 64;    // symbols before the grid is trusted
+
+        // relative clock offset of the sender, positive when its symbols are longer than nominal
+        // measured from the average spacing of the steered grid, which is much less noisy than
+        // the period estimate of the loop
+        double ppm() const {
+            if (count > settle * 2)
+                return ((strobe - period - anchor) / (count - settle) / nominal - 1) * 1e6;
+            return (period / nominal - 1) * 1e6;
+        }
+
+        // switch to a shorter symbol from the next one on, keeping the grid and the clock offset
+        // the offset measurement starts over on the new grid
+        void rescale(int new_period) {
+            auto ratio = period / nominal;
+            auto next = std::clamp(new_period, 1, base) * ratio;
+            strobe += next - period;
+            nominal = std::clamp(new_period, 1, base);
+            period = next;
+            count = 0;
+            last = 0;
+            anchor = 0;
+        }
+
+        // continue with a known clock offset, e.g. remembered from an earlier frame
+        void set_ppm(double ppm) {
+            period = nominal * (1 + std::clamp(ppm, -max_ppm, max_ppm) * 1e-6);
+        }
+
+    };
+
+    // automatic gain control with fast attack and slow release, scales the input so
+    // its peak envelope sits at target. the envelope is taken once per sub-block of
+    // `block` samples and the gain ramps linearly across the sub-block, so the per
+    // sample work is a max and a multiply that vectorize
+    class AGC {
+        float target, attack, release, max_gain;
+        int block;
+        float envelope, gain_;
+
+    public:
+        AGC(float target = 0.5, float attack = 0.9, float release = 0.01, float max_gain = 100, int block = 32)
+            : target(target), attack(attack), release(release), max_gain(max_gain), block(block) {
+            reset();
+        }
+
+        void reset() {
+            envelope = target;
+            gain_ = 1;
+        }
+
+        float gain() const { return gain_; }
+        float gain_db() const { return 20 * std::log10(gain_); }
+
+        void process(std::span<float> x) {
+            for (size_t begin = 0; begin < x.size(); begin += block) {
+                auto chunk = x.subspan(begin, std::min<size_t>(block, x.size() - begin));
+                float peak = 0;
+                for (auto v : chunk)
+                    peak = std::max(peak, std::abs(v));
+                envelope += (peak > envelope ? attack : release) * (peak - envelope);
+                auto next = target / std::max(envelope, target / max_gain);
+                // a louder block takes the lower gain at once, only the release is ramped
+                auto from = std::min(gain_, next);
+                auto step = (next - from) / chunk.size();
+                for (size_t i = 0; i < chunk.size(); i++)
+                    chunk[i] *= from + step * (i + 1);
+                gain_ = next;
+            }
+        }
+    };
+
+    // CFAR style detector: running mean and deviation of a detector statistic (energy,
+    // correlation) while nothing is there, a value is a detection when it stands k
+    // deviations above the mean. detections still pull the floor, only much slower,
+    // so a lasting change of the ambient level is followed instead of reading as busy forever
+    class NoiseFloor {
+        float alpha;
+        float mean_ = 0, var_ = 0;
+        int warmup = 0;             // updates left before detecting
+
+    public:
+        explicit NoiseFloor(float alpha = 0.01) : alpha(alpha) {
+            reset();
+        }
+
+        void reset() {
+            mean_ = var_ = 0;
+            warmup = int(1 / alpha);
+        }
+
+        float mean() const { return mean_; }
+        float deviation() const { return std::sqrt(var_); }
+        float threshold(float k) const { return mean_ + k * deviation(); }
+
+        // update with x, return whether x is a detection
+        bool detect(float x, float k) {
+            auto hit = warmup == 0 && x > threshold(k);
+            // a plain average while warming up, exponential afterwards
+            auto a = hit ? alpha / 64 : warmup > 0 ? std::max(alpha, 1.f / (int(1 / alpha) - warmup + 1)) : alpha;
+            auto d = x - mean_;
+            mean_ += a * d;
+            var_ = (1 - a) * (var_ + a * d * d);
+            if (warmup > 0)
+                warmup--;
+            return hit;
+        }
+    };
+
     
     int log2(int n) {
         return (n <= 1) ? 0 : 1 + log2(n / 2);
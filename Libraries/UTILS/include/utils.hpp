@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
 #include <vector>
 #include <span>
 #include <ranges>
@@ -16,13 +17,17 @@
 #include <mutex>
 #include <queue>
 #include <exception>
+#include <system_error>
 #include <condition_variable>
+#include <atomic>
 #include <boost/asio/streambuf.hpp>
 #include <format>
 #ifdef __GNUC__
 #include <cxxabi.h>
 #endif
 
+#include "fileio.hpp"
+
 
 namespace utils {
 
@@ -34,14 +39,20 @@ namespace utils {
         }
     }
 
+    // whitespace separated text, numbers are mapped and parsed with from_chars
+    // raw binary values are read with from_bin instead
     template<typename T>
-    inline std::vector<T> from_file(std::string fileName) {
-        std::vector<T> container;
-        std::ifstream dataFile { fileName };
-        T t;
-        while (dataFile >> t)
-            container.push_back(t);
-        return container;
+    inline std::vector<T> from_file(std::string fileName, size_t threads = 1) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            return parse_numbers<std::vector<T>>(MappedFile(fileName).text(), threads);
+        } else {
+            std::vector<T> container;
+            std::ifstream dataFile { fileName };
+            T t;
+            while (dataFile >> t)
+                container.push_back(t);
+            return container;
+        }
     }
 
     inline void to_file(std::string fileName, auto &&container) {
@@ -97,24 +108,18 @@ namespace utils {
                 push_back(bs[i]);
         }
 
+        // the bytes land in the packed words as they are, least significant bit first
         static auto from_bin(std::string fileName) {
-            std::ifstream dataFile { fileName, std::ios::binary };
-            if (!dataFile.is_open())
+            MappedFile file(fileName);
+            if (!file.is_open())
                 throw std::runtime_error(std::format("Cannot open file: {}", fileName));
-            BitsContainer container;
-            char byte;
-            while (dataFile.read(&byte, sizeof(byte)))
-                container.push(byte);
+            BitsContainer container(file.size() * CHAR_BIT);
+            std::memcpy(container.as_span<uint8_t>().data(), file.data(), file.size());
             return container;
         }
 
-        static auto from_file(std::string fileName) {
-            std::ifstream dataFile { fileName };
-            BitsContainer container;
-            bool bit;
-            while (dataFile >> bit)
-                container.push(bit);
-            return container;
+        static auto from_file(std::string fileName, size_t threads = 1) {
+            return parse_numbers<BitsContainer>(MappedFile(fileName).text(), threads);
         }
 
         void to_file(std::string fileName) {
@@ -124,10 +129,7 @@ namespace utils {
         }
 
         void to_bin(std::string fileName) {
-            std::ofstream dataFile { fileName, std::ios::binary };
-            char byte;
-            for (auto const &byte : as_span<char>())
-                dataFile.write(&byte, sizeof(byte));
+            utils::to_bin(fileName, std::as_const(*this).as_span<char>());
         }
 
         friend std::ostream &operator<<(std::ostream &os, const BitsContainer &container) {
@@ -138,6 +140,139 @@ namespace utils {
 
     };
 
+    // bits packed into 64 bit words, bit i is bit i % 64 of word i / 64, which
+    // is the order BitsContainer uses. appends and reads move up to a word at a
+    // time, and the words are plain memory on every standard library
+    class BitStream {
+
+        std::vector<uint64_t> words;
+        size_t nbits = 0;       // bits above nbits in the last word are kept zero
+
+        static constexpr uint64_t mask(int n) { return n < 64 ? (1ull << n) - 1 : ~0ull; }
+
+    public:
+        using value_type = bool;
+
+        BitStream() = default;
+        explicit BitStream(const std::vector<bool> &bits) {
+            reserve(bits.size());
+            for (bool bit : bits)
+                push_back(bit);
+        }
+        // the whole bytes straight from the packed words, only the tail bit by bit
+        explicit BitStream(const BitsContainer &bits) {
+            auto bytes = bits.as_span<uint8_t>();
+            append_bytes(bytes);
+            for (size_t i = bytes.size() * CHAR_BIT; i < bits.size(); i++)
+                push_back(bits[i]);
+        }
+
+        size_t size() const { return nbits; }
+        bool empty() const { return nbits == 0; }
+        void clear() { words.clear(); nbits = 0; }
+        void reserve(size_t bits) { words.reserve((bits + 63) / 64); }
+
+        bool operator[](size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+
+        void set(size_t i, bool bit) {
+            auto m = 1ull << (i % 64);
+            words[i / 64] = bit ? words[i / 64] | m : words[i / 64] & ~m;
+        }
+
+        void push_back(bool bit) { append_bits(bit, 1); }
+
+        // the low n bits of value, least significant first, n <= 64
+        void append_bits(uint64_t value, int n) {
+            if (n == 0)
+                return;
+            value &= mask(n);
+            auto offset = nbits % 64;
+            if (offset == 0)
+                words.push_back(value);
+            else {
+                words.back() |= value << offset;
+                if (offset + n > 64)
+                    words.push_back(value >> (64 - offset));
+            }
+            nbits += n;
+        }
+
+        // n <= 64 bits starting at pos, the first one in the lowest bit
+        uint64_t read_bits(size_t pos, int n) const {
+            if (n == 0)
+                return 0;
+            auto w = pos / 64, offset = pos % 64;
+            auto value = words[w] >> offset;
+            if (offset + n > 64)
+                value |= words[w + 1] << (64 - offset);
+            return value & mask(n);
+        }
+
+        void append_bytes(std::span<const uint8_t> bytes) {
+            reserve(nbits + bytes.size() * CHAR_BIT);
+            size_t i = 0;
+            for (; i + 8 <= bytes.size(); i += 8) {
+                uint64_t w = 0;
+                for (int k = 0; k < 8; k++)
+                    w |= uint64_t(bytes[i + k]) << (k * CHAR_BIT);
+                append_bits(w, 64);
+            }
+            for (; i < bytes.size(); i++)
+                append_bits(bytes[i], CHAR_BIT);
+        }
+
+        // out.size() bytes starting at bit pos
+        void read_bytes(size_t pos, std::span<uint8_t> out) const {
+            size_t i = 0;
+            for (; i + 8 <= out.size(); i += 8) {
+                auto w = read_bits(pos + i * CHAR_BIT, 64);
+                for (int k = 0; k < 8; k++)
+                    out[i + k] = uint8_t(w >> (k * CHAR_BIT));
+            }
+            for (; i < out.size(); i++)
+                out[i] = uint8_t(read_bits(pos + i * CHAR_BIT, CHAR_BIT));
+        }
+
+        std::span<const uint64_t> as_words() const { return words; }
+
+        template<typename T>
+        void push(T t) {
+            if constexpr (std::is_same_v<std::decay_t<T>, bool>)
+                push_back(t);
+            else {
+                static_assert(std::is_integral_v<T> && sizeof(T) <= sizeof(uint64_t));
+                append_bits(uint64_t(std::make_unsigned_t<T>(t)), sizeof(T) * CHAR_BIT);
+            }
+        }
+
+        template<size_t N>
+        void push(std::bitset<N> bs) {
+            static_assert(N <= 64);
+            append_bits(bs.to_ullong(), N);
+        }
+
+        // the i-th group of N bits
+        template<size_t N>
+        auto get(size_t i) const {
+            static_assert(N <= 64);
+            return std::bitset<N>(read_bits(i * N, N));
+        }
+
+        BitsContainer to_bits() const {
+            BitsContainer bits(nbits);
+            for (size_t i = 0; i < nbits; i++)
+                bits[i] = operator[](i);
+            return bits;
+        }
+
+        void to_file(std::string fileName) const {
+            std::ofstream dataFile { fileName };
+            for (size_t i = 0; i < nbits; i++)
+                dataFile << operator[](i) << '\n';
+        }
+
+    };
+
 
     class ByteContainer : public std::vector<uint8_t> {
 
@@ -176,21 +311,14 @@ namespace utils {
         }
 
         static auto from_bin(std::string fileName) {
-            std::ifstream dataFile { fileName, std::ios::binary };
-            if (!dataFile.is_open())
+            MappedFile file(fileName);
+            if (!file.is_open())
                 throw std::runtime_error(std::format("Cannot open file: {}", fileName));
-            ByteContainer container;
-            char byte;
-            while (dataFile.read(&byte, sizeof(byte)))
-                container.push_back(byte);
-            return container;
+            return ByteContainer(file.bytes().begin(), file.bytes().end());
         }
 
         void to_bin(std::string fileName) {
-            std::ofstream dataFile { fileName, std::ios::binary };
-            char byte;
-            for (auto const &byte : as_span<char>())
-                dataFile.write(&byte, sizeof(byte));
+            utils::to_bin(fileName, std::as_const(*this).as_span<char>());
         }
 
         friend std::ostream &operator<<(std::ostream &os, const ByteContainer &container) {
@@ -206,6 +334,151 @@ namespace utils {
 
     };
 
+    // a packet with reserved room in front and behind, in the style of sk_buff.
+    // going down, every layer prepends its header in O(1) into the headroom;
+    // going up, pull_header strips it by moving the front, and copies or slices
+    // share the same reference counted storage instead of copying the payload.
+    // writes to shared storage copy it first, so a slice handed to an upper
+    // layer never sees a lower layer reuse its buffer
+    class PacketBuffer {
+
+        std::shared_ptr<uint8_t[]> storage;
+        size_t capacity = 0;
+        size_t head = 0, tail = 0;      // the packet is [head, tail) of storage
+
+        // make the storage exclusive and grow it so that front and back bytes fit
+        void reserve(size_t front, size_t back) {
+            if (storage && storage.use_count() == 1 && head >= front && capacity - tail >= back)
+                return;
+            auto newHead = std::max(front, head);
+            auto newCapacity = newHead + size() + std::max(back, capacity - tail);
+            // double on growth so repeated pushes stay amortized O(1)
+            if (newCapacity > capacity)
+                newCapacity = std::max(newCapacity, capacity * 2);
+            auto newStorage = std::make_shared_for_overwrite<uint8_t[]>(newCapacity);
+            if (storage)
+                std::copy_n(storage.get() + head, size(), newStorage.get() + newHead);
+            tail = newHead + size();
+            head = newHead;
+            capacity = newCapacity;
+            storage = std::move(newStorage);
+        }
+
+    public:
+        using value_type = uint8_t;
+
+        static constexpr size_t default_headroom = 32;
+        static constexpr size_t default_tailroom = 8;
+
+        PacketBuffer() = default;
+
+        explicit PacketBuffer(size_t size, size_t headroom = default_headroom, size_t tailroom = default_tailroom)
+            : storage(std::make_shared<uint8_t[]>(headroom + size + tailroom)),
+              capacity(headroom + size + tailroom), head(headroom), tail(headroom + size) { }
+
+        explicit PacketBuffer(std::span<const uint8_t> payload, size_t headroom = default_headroom, size_t tailroom = default_tailroom)
+            : PacketBuffer(payload.size(), headroom, tailroom) {
+            std::copy(payload.begin(), payload.end(), begin());
+        }
+
+        // the header stack is empty, reserve room for every layer that adds one
+        static PacketBuffer with_headroom(size_t headroom, size_t tailroom = default_tailroom) {
+            return PacketBuffer(0, headroom, tailroom);
+        }
+
+        uint8_t *data() { reserve(0, 0); return storage.get() + head; }
+        const uint8_t *data() const { return storage.get() + head; }
+        size_t size() const { return tail - head; }
+        bool empty() const { return head == tail; }
+        size_t headroom() const { return head; }
+        size_t tailroom() const { return capacity - tail; }
+
+        uint8_t *begin() { return data(); }
+        uint8_t *end() { return data() + size(); }
+        const uint8_t *begin() const { return data(); }
+        const uint8_t *end() const { return data() + size(); }
+
+        uint8_t &operator[](size_t i) { return data()[i]; }
+        uint8_t operator[](size_t i) const { return data()[i]; }
+
+        operator std::span<const uint8_t>() const { return { data(), size() }; }
+
+        // whether another buffer still references the storage
+        bool shared() const { return storage.use_count() > 1; }
+
+        // prepend a header, O(1) while the headroom lasts
+        void push_header(const auto &t) {
+            static_assert(std::is_trivially_copyable_v<std::decay_t<decltype(t)>>);
+            reserve(sizeof(t), 0);
+            head -= sizeof(t);
+            auto sp = std::span((const uint8_t *)&t, sizeof(t));
+            std::copy(sp.begin(), sp.end(), storage.get() + head);
+        }
+
+        // read the header in front and strip it, nullopt if the packet is too short
+        template<typename T>
+        std::optional<T> pull_header() {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (size() < sizeof(T))
+                return std::nullopt;
+            T t;
+            std::copy_n(data(), sizeof(T), (uint8_t *)&t);
+            head += sizeof(T);
+            return t;
+        }
+
+        template<typename T>
+        std::optional<T> peek_header() const {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (size() < sizeof(T))
+                return std::nullopt;
+            T t;
+            std::copy_n(data(), sizeof(T), (uint8_t *)&t);
+            return t;
+        }
+
+        void push(const auto &t) {
+            static_assert(std::is_trivially_copyable_v<std::decay_t<decltype(t)>>);
+            append(std::span((const uint8_t *)&t, sizeof(t)));
+        }
+
+        void push_back(uint8_t byte) {
+            reserve(0, 1);
+            storage[tail++] = byte;
+        }
+
+        void append(std::span<const uint8_t> bytes) {
+            reserve(0, bytes.size());
+            std::copy(bytes.begin(), bytes.end(), storage.get() + tail);
+            tail += bytes.size();
+        }
+
+        // drop bytes from the front or the back, the storage is kept
+        void trim_front(size_t n) { head += std::min(n, size()); }
+        void trim_back(size_t n) { tail -= std::min(n, size()); }
+
+        // restart an empty packet with the same headroom, reuses exclusive storage
+        void clear(size_t headroom = default_headroom) {
+            if (shared())
+                storage.reset();
+            if (!storage || capacity < headroom)
+                *this = with_headroom(headroom);
+            head = tail = headroom;
+        }
+
+        // a view of [offset, offset + n) sharing the storage, no bytes are copied
+        PacketBuffer slice(size_t offset, size_t n = SIZE_MAX) const {
+            PacketBuffer s = *this;
+            s.head += std::min(offset, size());
+            s.tail = s.head + std::min(n, tail - s.head);
+            return s;
+        }
+
+        ByteContainer to_bytes() const { return ByteContainer(begin(), end()); }
+
+    };
+
+
 
     class BitView {
         std::uint8_t *_data;
@@ -266,40 +539,315 @@ namespace utils {
 
     };
 
-    class PacketStreamBuffer : public boost::asio::streambuf {
+    // bounded lock-free single-producer single-consumer ring
+    // the consumer neither allocates nor destroys elements, a popped slot
+    // keeps its value until the producer overwrites it
+    template <typename T>
+    class SPSCQueue {
 
-        std::queue<size_t> packet_sizes;
+        std::vector<T> slots;
+        alignas(64) std::atomic<size_t> head = 0;   // next slot to read, owned by the consumer
+        alignas(64) std::atomic<size_t> tail = 0;   // next slot to write, owned by the producer
 
     public:
+        explicit SPSCQueue(size_t capacity) : slots(capacity) { }
+
+        bool try_push(T &&value) {
+            auto t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) == slots.size())
+                return false;
+            slots[t % slots.size()] = std::move(value);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // the oldest element, or nullptr if the queue is empty
+        T *front() {
+            auto h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+                return nullptr;
+            return &slots[h % slots.size()];
+        }
 
-        std::size_t front_packet_size() {
-            return packet_sizes.empty() ? 0 : packet_sizes.front();
+        void pop() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
         }
 
-        using boost::asio::streambuf::prepare;
-        using boost::asio::streambuf::data;
+        bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
 
-        void commit(std::size_t n) {
-            boost::asio::streambuf::commit(n);
-            packet_sizes.push(n);
+        size_t size() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
         }
 
-        void consume(std::size_t n) {
-            boost::asio::streambuf::consume(n);
-            while (n > 0 && !packet_sizes.empty()) {
-                if (packet_sizes.front() <= n) {
-                    n -= packet_sizes.front();
-                    packet_sizes.pop();
+        size_t capacity() const {
+            return slots.size();
+        }
+
+    };
+
+    // bounded lock-free multi-producer multi-consumer ring (Vyukov)
+    // every cell carries a sequence number telling whose turn it is, so a
+    // push or pop is one CAS on tail or head and threads never wait on a lock
+    // the batch versions claim a run of ready cells with a single CAS
+    template <typename T>
+    class MPMCQueue {
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        const size_t mask;
+        alignas(64) std::atomic<size_t> head = 0;   // next position to pop
+        alignas(64) std::atomic<size_t> tail = 0;   // next position to push
+
+        // cells ready at pos, pos + 1, ... up to n, a cell is ready when its
+        // sequence is pos + offset (free for the producer, full for the consumer)
+        size_t ready(size_t pos, size_t offset, size_t n) const {
+            size_t k = 0;
+            while (k < n && k <= mask && cells[(pos + k) & mask].sequence.load(std::memory_order_acquire) == pos + k + offset)
+                k++;
+            return k;
+        }
+
+        // claim up to n ready cells on counter, 0 if none is ready
+        size_t claim(std::atomic<size_t> &counter, size_t offset, size_t n, size_t &pos) {
+            pos = counter.load(std::memory_order_relaxed);
+            for (;;) {
+                auto k = ready(pos, offset, n);
+                if (k == 0) {
+                    auto diff = (ptrdiff_t)(cells[pos & mask].sequence.load(std::memory_order_acquire) - (pos + offset));
+                    if (diff < 0)
+                        return 0;   // full for the producer, empty for the consumer
+                    pos = counter.load(std::memory_order_relaxed);
+                } else if (counter.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                    return k;
                 }
-                else {
-                    packet_sizes.front() -= n;
+            }
+        }
+
+    public:
+        // the capacity is rounded up to a power of two
+        explicit MPMCQueue(size_t capacity)
+            : cells(new Cell[std::bit_ceil(std::max<size_t>(capacity, 2))]), mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1) {
+            for (size_t i = 0; i <= mask; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MPMCQueue(const MPMCQueue &) = delete;
+        MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+        bool try_push(T &&value) {
+            return try_push_batch(std::span(&value, 1)) == 1;
+        }
+
+        std::optional<T> try_pop() {
+            size_t pos;
+            if (claim(head, 1, 1, pos) == 0)
+                return std::nullopt;
+            auto &cell = cells[pos & mask];
+            std::optional<T> value(std::move(cell.value));
+            cell.sequence.store(pos + mask + 1, std::memory_order_release);
+            return value;
+        }
+
+        // move the front of values in, return how many fit
+        size_t try_push_batch(std::span<T> values) {
+            size_t pos;
+            auto n = claim(tail, 0, values.size(), pos);
+            for (size_t i = 0; i < n; i++) {
+                auto &cell = cells[(pos + i) & mask];
+                cell.value = std::move(values[i]);
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            return n;
+        }
+
+        // fill the front of out, return how many were popped
+        size_t try_pop_batch(std::span<T> out) {
+            size_t pos;
+            auto n = claim(head, 1, out.size(), pos);
+            for (size_t i = 0; i < n; i++) {
+                auto &cell = cells[(pos + i) & mask];
+                out[i] = std::move(cell.value);
+                cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+            }
+            return n;
+        }
+
+        // a snapshot, exact only while no one pushes or pops
+        size_t size() const {
+            auto h = head.load(std::memory_order_acquire);
+            auto t = tail.load(std::memory_order_acquire);
+            return t > h ? std::min(t - h, capacity()) : 0;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        size_t capacity() const {
+            return mask + 1;
+        }
+
+    };
+
+    // the last `size` samples of a stream, always contiguous in memory so kernels
+    // such as Signals::dot can run over them. every sample is written twice,
+    // at i and i + size, instead of shifting a deque
+    template <typename T>
+    class SlidingWindow {
+
+        std::vector<T> buffer;
+        size_t n = 0;       // samples pushed since clear
+
+    public:
+        explicit SlidingWindow(size_t size) : buffer(2 * size) { }
+
+        void push(T value) {
+            auto i = n++ % size();
+            buffer[i] = buffer[i + size()] = value;
+        }
+
+        // oldest to newest
+        const T *data() const {
+            return buffer.data() + n % size();
+        }
+
+        T front() const {
+            return data()[0];
+        }
+
+        bool full() const {
+            return n >= size();
+        }
+
+        size_t size() const {
+            return buffer.size() / 2;
+        }
+
+        void clear() {
+            n = 0;
+        }
+
+    };
+
+    // fixed capacity transmit ring for one producer and one consumer
+    // every commit is a packet, a slot holding a span of one preallocated
+    // sample arena. a packet never wraps around the arena, the producer skips
+    // the tail instead, so the consumer reads each packet as a single span and
+    // neither side allocates after construction
+    template <typename T>
+    class PacketRing {
+
+        struct Slot {
+            size_t start, size;     // absolute sample positions, modulo the arena size
+        };
+
+        std::unique_ptr<T[]> arena;
+        const size_t arenaSize;
+        std::vector<Slot> slots;
+
+        alignas(64) std::atomic<size_t> slotHead = 0;   // consumer
+        std::atomic<size_t> sampleHead = 0;             // first sample still in use
+        std::atomic<size_t> samplesOut = 0;
+        size_t consumed = 0;                            // samples read from the front packet
+
+        alignas(64) std::atomic<size_t> slotTail = 0;   // producer
+        std::atomic<size_t> samplesIn = 0;
+        size_t sampleTail = 0;                          // end of the last packet
+        size_t prepared = 0;                            // start of the prepared span
+
+    public:
+        PacketRing(size_t samples, size_t packets)
+            : arena(new T[samples]), arenaSize(samples), slots(packets) { }
+
+        PacketRing(const PacketRing &) = delete;
+        PacketRing &operator=(const PacketRing &) = delete;
+
+        // room for a packet of up to n samples, empty while the ring is too full
+        // a packet that can never fit is empty with ec set to message_size
+        std::span<T> prepare(size_t n, std::error_code &ec) {
+            ec.clear();
+            if (n > arenaSize) {
+                ec = std::make_error_code(std::errc::message_size);
+                return {};
+            }
+            if (slotTail.load(std::memory_order_relaxed) - slotHead.load(std::memory_order_acquire) == slots.size())
+                return {};
+            auto start = sampleTail;
+            if (start % arenaSize + n > arenaSize)
+                start += arenaSize - start % arenaSize;
+            if (start + n - sampleHead.load(std::memory_order_acquire) > arenaSize)
+                return {};
+            prepared = start;
+            return { &arena[start % arenaSize], n };
+        }
+
+        // publish the first n samples of the last prepare as a packet
+        // an empty commit adds no packet
+        void commit(size_t n) {
+            if (n == 0)
+                return;
+            auto t = slotTail.load(std::memory_order_relaxed);
+            slots[t % slots.size()] = { prepared, n };
+            sampleTail = prepared + n;
+            slotTail.store(t + 1, std::memory_order_release);
+            // after the slot, so size() never counts samples front() cannot see yet
+            samplesIn.fetch_add(n, std::memory_order_release);
+        }
+
+        // the unread part of the front packet, empty if there is none
+        std::span<const T> front() const {
+            auto h = slotHead.load(std::memory_order_relaxed);
+            if (h == slotTail.load(std::memory_order_acquire))
+                return {};
+            auto &slot = slots[h % slots.size()];
+            return { &arena[(slot.start + consumed) % arenaSize], slot.size - consumed };
+        }
+
+        // drop n samples from the front, packets that are used up leave the ring
+        void consume(size_t n) {
+            auto h = slotHead.load(std::memory_order_relaxed);
+            auto t = slotTail.load(std::memory_order_acquire);
+            auto head = sampleHead.load(std::memory_order_relaxed);
+            size_t dropped = 0;
+            while (n > 0 && h != t) {
+                auto &slot = slots[h % slots.size()];
+                auto k = std::min(n, slot.size - consumed);
+                consumed += k;
+                n -= k;
+                dropped += k;
+                head = slot.start + consumed;
+                if (consumed < slot.size)
                     break;
-                }
+                consumed = 0;
+                h++;
             }
+            samplesOut.fetch_add(dropped, std::memory_order_relaxed);
+            sampleHead.store(head, std::memory_order_release);
+            slotHead.store(h, std::memory_order_release);
+        }
+
+        // samples of the front packet still to be read
+        size_t front_packet_size() const {
+            return front().size();
+        }
+
+        size_t num_packets_left() const {
+            return slotTail.load(std::memory_order_acquire) - slotHead.load(std::memory_order_acquire);
+        }
+
+        // samples in all packets, exact on the consumer side
+        size_t size() const {
+            return samplesIn.load(std::memory_order_acquire) - samplesOut.load(std::memory_order_relaxed);
         }
 
-        std::size_t num_packets_left() {
-            return packet_sizes.size();
+        size_t capacity() const {
+            return arenaSize;
         }
 
     };